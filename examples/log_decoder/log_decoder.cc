@@ -0,0 +1,76 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "fishnet/base/log_record.h"
+#include "fishnet/base/logging.h"
+#include "fishnet/base/time_zone.h"
+
+using namespace fishnet;
+
+// Formats the binary records of Logger::setBinary() in log files, or stdin,
+// to stdout. Text lines among them are copied as they are.
+
+namespace {
+
+bool decode(FILE* in, const char* name) {
+    char buf[64 * 1024];
+    string pending;
+    string out;
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        pending.append(buf, n);
+        out.clear();
+        size_t consumed = log_record::format(pending.data(), pending.size(), &out);
+        fwrite(out.data(), 1, out.size(), stdout);
+        pending.erase(0, consumed);
+    }
+    if (ferror(in)) {
+        fprintf(stderr, "%s: %s\n", name, strerror_tl(errno));
+        return false;
+    }
+    if (!pending.empty()) {
+        if (pending[0] != log_record::kMagic) {
+            // a last line without its newline
+            fwrite(pending.data(), 1, pending.size(), stdout);
+        } else {
+            fprintf(stderr, "%s: %zd bytes of a record cut off at the end\n", name,
+                    pending.size());
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        fprintf(stderr, "Usage: log_decoder [-z zonefile] [file...]\n");
+        return 0;
+    }
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-z") == 0) {
+        TimeZone tz{argv[2]};
+        if (!tz.valid()) {
+            fprintf(stderr, "%s: not a time zone file\n", argv[2]);
+            return 1;
+        }
+        Logger::setTimeZone(tz);
+        first = 3;
+    }
+    bool ok = true;
+    if (first == argc) {
+        ok = decode(stdin, "stdin");
+    }
+    for (int i = first; i < argc; ++i) {
+        FILE* in = fopen(argv[i], "rb");
+        if (in == NULL) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror_tl(errno));
+            ok = false;
+            continue;
+        }
+        ok = decode(in, argv[i]) && ok;
+        fclose(in);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Compare pollers with the pingpong pair, e.g.
+#   ./bench.sh ./_gate_build/bin 4 16384 100 10
+# runs the same load against EPollPoller and IoUringPoller.
+
+bindir=${1:-./bin}
+threads=${2:-1}
+blocksize=${3:-16384}
+sessions=${4:-100}
+seconds=${5:-10}
+port=33333
+
+run() {
+    name=$1
+    shift
+    echo "==== $name, $threads threads, $sessions sessions, $blocksize bytes"
+    env "$@" "$bindir/pingpong_server" 0.0.0.0 $port $threads &
+    srv=$!
+    sleep 1
+    env "$@" "$bindir/pingpong_client" 127.0.0.1 $port $threads $blocksize $sessions $seconds
+    kill $srv
+    wait $srv 2>/dev/null
+}
+
+run epoll
+run io_uring FISHNET_USE_IO_URING=1
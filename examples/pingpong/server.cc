@@ -30,7 +30,7 @@ int main(int argc, char* argv[]) {
     }
 
     LOG_INFO << "pid = " << getpid() << ", tid = " << current_thread::tid();
-    Logger::setLogLevel(Logger::LogLevel::TRACE);
+    Logger::setLogLevel(Logger::LogLevel::WARN);
 
     const char* ip = argv[1];
     uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
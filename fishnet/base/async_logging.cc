@@ -1,12 +1,214 @@
 #include "fishnet/base/async_logging.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
 #include <cstdio>
+#include <cstring>
 
 #include "fishnet/base/log_file.h"
+#include "fishnet/base/log_record.h"
 #include "fishnet/base/timestamp.h"
 
 using namespace fishnet;
 
+namespace fishnet {
+extern const char* LogLevelName[];
+}  // namespace fishnet
+
+const int AsyncLogging::kDefaultSegmentSize;
+const int AsyncLogging::kDefaultThreadSegments;
+const size_t AsyncLogging::kNumLevels;
+const size_t AsyncLogging::kMaxBuffers;
+
+namespace {
+
+std::atomic<int64_t> g_nextId(1);
+
+// the ThreadBuffers of this thread in the AsyncLogging last appended to
+__thread int64_t t_ownerId = 0;
+__thread void* t_threadBuffers = NULL;
+
+// a line harvested from a segment
+struct Record {
+    int64_t micros;
+    const char* data;
+    int len;
+};
+
+// the harvested lines of one thread, records[next, end)
+struct Run {
+    size_t next;
+    size_t end;
+};
+
+// of a JSON line, {"time":"...","tid":1234,"level":"WARN",...
+bool parseJsonLevel(const char* line, int len, Logger::LogLevel* level) {
+    static const char kKey[] = "\"level\":\"";
+    // ahead of the fields and message
+    const size_t kMaxOffset = 64;
+    const void* key = memmem(line, std::min(static_cast<size_t>(len), kMaxOffset + sizeof(kKey)),
+                             kKey, sizeof(kKey) - 1);
+    if (key == NULL) {
+        return false;
+    }
+    const char* p = static_cast<const char*>(key) + sizeof(kKey) - 1;
+    const size_t rest = static_cast<size_t>(line + len - p);
+    for (size_t i = 0; i < static_cast<size_t>(Logger::LogLevel::NUM_LOG_LEVELS); ++i) {
+        size_t n = strcspn(LogLevelName[i], " ");
+        if (rest > n && memcmp(p, LogLevelName[i], n) == 0 && p[n] == '"') {
+            *level = static_cast<Logger::LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// the level of a line as Logger::Impl formats it,
+// "20240102 03:04:05.678901Z  1234 WARN  ..."
+bool parseLevel(const char* line, int len, Logger::LogLevel* level) {
+    if (len > 0 && line[0] == '{') {
+        return parseJsonLevel(line, len, level);
+    }
+    const char* p = line;
+    const char* const end = line + len;
+    // the date, the time
+    for (int i = 0; i < 2; ++i) {
+        p = static_cast<const char*>(memchr(p, ' ', static_cast<size_t>(end - p)));
+        if (p == NULL) {
+            return false;
+        }
+        ++p;
+    }
+    // the tid, right aligned
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+    while (p < end && isdigit(static_cast<unsigned char>(*p))) {
+        ++p;
+    }
+    if (p == end || *p != ' ') {
+        return false;
+    }
+    ++p;
+    const size_t kNameLen = 6;
+    if (static_cast<size_t>(end - p) < kNameLen) {
+        return false;
+    }
+    for (size_t i = 0; i < static_cast<size_t>(Logger::LogLevel::NUM_LOG_LEVELS); ++i) {
+        if (memcmp(p, LogLevelName[i], kNameLen) == 0) {
+            *level = static_cast<Logger::LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::LogLevel levelOf(const char* logline, int len) {
+    int record = log_record::level(logline, static_cast<size_t>(len));
+    if (record >= 0) {
+        return static_cast<Logger::LogLevel>(record);
+    }
+    Logger::LogLevel level = Logger::LogLevel::INFO;
+    parseLevel(logline, len, &level);
+    return level;
+}
+
+int64_t total(const std::atomic<int64_t>* counters, size_t n) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += counters[i].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void report(LogFile* output, const char* what, int64_t bytes) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s %" PRId64 " bytes of log messages at %s\n", what, bytes,
+             Timestamp::now().toFormattedString().c_str());
+    fputs(buf, stderr);
+    output->append(buf, static_cast<int>(strlen(buf)));
+}
+
+}  // namespace
+
+// the lines back to back, so that runs of them are written at once, and
+// when each was appended
+struct AsyncLogging::Segment {
+    // shorter lines on average fill the index before the bytes
+    static const int kAverageLine = 32;
+
+    explicit Segment(int size)
+        : data(new char[size]),
+          capacity(size),
+          length(0),
+          maxLines(size / kAverageLine),
+          micros(new int64_t[maxLines]),
+          ends(new int[maxLines]),
+          committed(0) {}
+
+    int avail() const {
+        return capacity - length;
+    }
+
+    const std::unique_ptr<char[]> data;
+    const int capacity;
+    int length;  // thread only
+    const int maxLines;
+    const std::unique_ptr<int64_t[]> micros;
+    const std::unique_ptr<int[]> ends;  // of each line in data
+    std::atomic<int> committed;         // lines the backend may read
+};
+
+///
+/// Single producer, single consumer ring of segments.
+///
+/// The thread fills segments[sealed % n] and moves on to the next once it is
+/// full, if the backend has released that one. The backend reads sealed
+/// segments and the committed part of the current one, and releases a
+/// sealed segment once written.
+struct AsyncLogging::ThreadBuffers {
+    ThreadBuffers(int numSegments, int segmentSize)
+        : segments(static_cast<size_t>(numSegments)),
+          size(static_cast<uint64_t>(numSegments)),
+          sealed(0),
+          released(0),
+          harvested(0),
+          reserved(false),
+          exited(false) {
+        segments[0].reset(new Segment(segmentSize));
+    }
+
+    std::vector<std::unique_ptr<Segment>> segments;
+    const uint64_t size;
+    std::atomic<uint64_t> sealed;    // written by the thread
+    std::atomic<uint64_t> released;  // written by the backend
+    int harvested;  // lines of segments[released % n], backend only
+    // the current segment is the last free one, thread only
+    bool reserved;
+    // the thread appends no more, the backend frees the ring once written
+    std::atomic<bool> exited;
+};
+
+// the ring of a thread, let go of when the thread exits
+struct AsyncLogging::RingOwner {
+    RingOwner() : buffers(NULL) {}
+
+    ~RingOwner() {
+        if (buffers == NULL) {
+            return;
+        }
+        // what the thread logs from here on goes to a new ring
+        if (t_threadBuffers == buffers) {
+            t_ownerId = 0;
+            t_threadBuffers = NULL;
+        }
+        buffers->exited.store(true, std::memory_order_release);
+    }
+
+    ThreadBuffers* buffers;
+};
+
 AsyncLogging::AsyncLogging(const string& basename, off_t rollSize,
                            int flushInterval)
     : flushInterval_(flushInterval),
@@ -17,16 +219,43 @@ AsyncLogging::AsyncLogging(const string& basename, off_t rollSize,
       latch_(1),
       mutex_(),
       cond_(mutex_),
+      notFull_(mutex_),
       currentBuffer_(new Buffer),
       nextBuffer_(new Buffer),
-      buffers_() {
+      buffers_(),
+      perThreadBuffers_(false),
+      id_(g_nextId.fetch_add(1)),
+      segmentSize_(kDefaultSegmentSize),
+      threadSegments_(kDefaultThreadSegments),
+      segmentSealed_(false),
+      overflowPolicy_(OverflowPolicy::kDrop),
+      blockTimeout_(1.0),
+      formatRecords_(false) {
+    for (size_t i = 0; i < kNumLevels; ++i) {
+        droppedBytes_[i].store(0, std::memory_order_relaxed);
+        spilledBytes_[i].store(0, std::memory_order_relaxed);
+    }
     currentBuffer_->bzero();
     nextBuffer_->bzero();
     buffers_.reserve(16);
 }
 
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
 void AsyncLogging::append(const char* logline, int len) {
+    if (perThreadBuffers_) {
+        appendToThreadBuffers(logline, len);
+        return;
+    }
     fishnet::MutexLockGuard lock(mutex_);
+    if (currentBuffer_->avail() <= len && buffers_.size() >= kMaxBuffers &&
+        !admitOverflow(logline, len)) {
+        return;
+    }
     if (currentBuffer_->avail() > len) {
         currentBuffer_->append(logline, len);
     } else {
@@ -41,23 +270,322 @@ void AsyncLogging::append(const char* logline, int len) {
     }
 }
 
+bool AsyncLogging::admitOverflow(const char* logline, int len) {
+    switch (overflowPolicy_) {
+        case OverflowPolicy::kBlock: {
+            Timestamp deadline = addTime(Timestamp::now(), blockTimeout_);
+            while (currentBuffer_->avail() <= len && buffers_.size() >= kMaxBuffers &&
+                   running_) {
+                double seconds = timeDifference(deadline, Timestamp::now());
+                if (seconds <= 0) {
+                    droppedBytes_[static_cast<size_t>(levelOf(logline, len))].fetch_add(
+                        len, std::memory_order_relaxed);
+                    return false;
+                }
+                notFull_.waitForSeconds(seconds);
+            }
+            return true;
+        }
+        case OverflowPolicy::kDropBySeverity: {
+            // the backend trims nothing then, bound it here
+            Logger::LogLevel level = levelOf(logline, len);
+            if (level >= Logger::LogLevel::WARN && buffers_.size() < 2 * kMaxBuffers) {
+                return true;
+            }
+            droppedBytes_[static_cast<size_t>(level)].fetch_add(len,
+                                                                std::memory_order_relaxed);
+            return false;
+        }
+        default:
+            // left to the backend
+            return true;
+    }
+}
+
+AsyncLogging::ThreadBuffers* AsyncLogging::threadBuffers() {
+    if (t_ownerId == id_) {
+        return static_cast<ThreadBuffers*>(t_threadBuffers);
+    }
+    RingOwner& owner = ringOwners_.value();
+    if (owner.buffers == NULL) {
+        owner.buffers = new ThreadBuffers(threadSegments_, segmentSize_);
+        fishnet::MutexLockGuard lock(mutex_);
+        threadBuffers_.emplace_back(owner.buffers);
+    }
+    t_ownerId = id_;
+    t_threadBuffers = owner.buffers;
+    return owner.buffers;
+}
+
+void AsyncLogging::appendToThreadBuffers(const char* logline, int len) {
+    if (len > segmentSize_) {
+        droppedBytes_[static_cast<size_t>(levelOf(logline, len))].fetch_add(
+            len, std::memory_order_relaxed);
+        return;
+    }
+    ThreadBuffers* buffers = threadBuffers();
+    uint64_t sealed = buffers->sealed.load(std::memory_order_relaxed);
+    Segment* segment = buffers->segments[sealed % buffers->size].get();
+    int lines = segment->committed.load(std::memory_order_relaxed);
+    if (buffers->reserved) {
+        // kept for WARN and above until the backend frees a segment
+        buffers->reserved =
+            sealed + 1 - buffers->released.load(std::memory_order_acquire) >= buffers->size;
+        Logger::LogLevel level = levelOf(logline, len);
+        if (buffers->reserved && level < Logger::LogLevel::WARN) {
+            droppedBytes_[static_cast<size_t>(level)].fetch_add(len, std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (segment->avail() < len || lines == segment->maxLines) {
+        if (sealed + 1 - buffers->released.load(std::memory_order_acquire) >= buffers->size &&
+            !admitOverflow(buffers, logline, len)) {
+            return;
+        }
+        std::unique_ptr<Segment>& next = buffers->segments[(sealed + 1) % buffers->size];
+        if (!next) {
+            next.reset(new Segment(segmentSize_));
+        } else {
+            next->length = 0;
+            next->committed.store(0, std::memory_order_relaxed);
+        }
+        buffers->sealed.store(sealed + 1, std::memory_order_release);
+        buffers->reserved =
+            overflowPolicy_ == OverflowPolicy::kDropBySeverity &&
+            sealed + 2 - buffers->released.load(std::memory_order_acquire) >= buffers->size;
+        segment = next.get();
+        lines = 0;
+        {
+            fishnet::MutexLockGuard lock(mutex_);
+            segmentSealed_ = true;
+            cond_.notify();
+        }
+    }
+    memcpy(segment->data.get() + segment->length, logline, static_cast<size_t>(len));
+    segment->length += len;
+    segment->micros[lines] = Timestamp::now().microSecondsSinceEpoch();
+    segment->ends[lines] = segment->length;
+    segment->committed.store(lines + 1, std::memory_order_release);
+}
+
+bool AsyncLogging::admitOverflow(ThreadBuffers* buffers, const char* logline, int len) {
+    const uint64_t sealed = buffers->sealed.load(std::memory_order_relaxed);
+    if (overflowPolicy_ == OverflowPolicy::kBlock) {
+        fishnet::MutexLockGuard lock(mutex_);
+        Timestamp deadline = addTime(Timestamp::now(), blockTimeout_);
+        // harvest() releases, then notifies under mutex_
+        while (sealed + 1 - buffers->released.load(std::memory_order_acquire) >= buffers->size) {
+            double seconds = timeDifference(deadline, Timestamp::now());
+            if (!running_ || seconds <= 0) {
+                droppedBytes_[static_cast<size_t>(levelOf(logline, len))].fetch_add(
+                    len, std::memory_order_relaxed);
+                return false;
+            }
+            notFull_.waitForSeconds(seconds);
+        }
+        return true;
+    }
+    Logger::LogLevel level = levelOf(logline, len);
+    if (overflowPolicy_ == OverflowPolicy::kSpill && spillFile_) {
+        spillFile_->append(logline, len);
+        spilledBytes_[static_cast<size_t>(level)].fetch_add(len, std::memory_order_relaxed);
+    } else {
+        droppedBytes_[static_cast<size_t>(level)].fetch_add(len, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+void AsyncLogging::count(std::atomic<int64_t>* counters, const char* data, int len) {
+    int64_t bytes[kNumLevels] = {0};
+    // a line of a message spanning several goes with the one before
+    Logger::LogLevel level = Logger::LogLevel::INFO;
+    const char* const end = data + len;
+    for (const char* line = data; line < end;) {
+        const size_t record = log_record::length(line, static_cast<size_t>(end - line));
+        const char* next = NULL;
+        if (record != 0) {
+            next = line + record;
+            level = static_cast<Logger::LogLevel>(log_record::level(line, record));
+        } else {
+            const void* eol = memchr(line, '\n', static_cast<size_t>(end - line));
+            next = eol == NULL ? end : static_cast<const char*>(eol) + 1;
+            parseLevel(line, static_cast<int>(next - line), &level);
+        }
+        bytes[static_cast<size_t>(level)] += next - line;
+        line = next;
+    }
+    for (size_t i = 0; i < kNumLevels; ++i) {
+        if (bytes[i] != 0) {
+            counters[i].fetch_add(bytes[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogging::write(LogFile* output, const char* data, int len) {
+    if (!formatRecords_) {
+        output->append(data, len);
+        return;
+    }
+    formatted_.clear();
+    log_record::format(data, static_cast<size_t>(len), &formatted_);
+    output->append(formatted_.data(), static_cast<int>(formatted_.size()));
+}
+
+void AsyncLogging::harvest(LogFile* output) {
+    std::vector<ThreadBuffers*> threads;
+    {
+        fishnet::MutexLockGuard lock(mutex_);
+        threads.reserve(threadBuffers_.size());
+        for (const auto& item : threadBuffers_) {
+            threads.push_back(item.get());
+        }
+    }
+
+    std::vector<Record> records;
+    std::vector<Run> runs(threads.size());
+    std::vector<uint64_t> released(threads.size());
+    std::vector<ThreadBuffers*> exited;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        ThreadBuffers* buffers = threads[i];
+        runs[i].next = records.size();
+        // ahead of the rest, then all the thread appended is read below
+        if (buffers->exited.load(std::memory_order_acquire)) {
+            exited.push_back(buffers);
+        }
+        const uint64_t sealed = buffers->sealed.load(std::memory_order_acquire);
+        uint64_t n = buffers->released.load(std::memory_order_relaxed);
+        // the sealed segments, then what's committed of the current one
+        for (;; ++n) {
+            const Segment* segment = buffers->segments[n % buffers->size].get();
+            const int committed = segment->committed.load(std::memory_order_acquire);
+            const char* data = segment->data.get();
+            for (int line = buffers->harvested; line < committed; ++line) {
+                int begin = line == 0 ? 0 : segment->ends[line - 1];
+                Record record = {segment->micros[line], data + begin,
+                                 segment->ends[line] - begin};
+                records.push_back(record);
+            }
+            if (n == sealed) {
+                buffers->harvested = committed;
+                break;
+            }
+            buffers->harvested = 0;
+        }
+        released[i] = n;
+        runs[i].end = records.size();
+    }
+
+    // each thread's lines are in order already, merge them: write the lines
+    // of the thread with the earliest one up to the earliest of the others,
+    // what is adjacent in its segment at once
+    for (;;) {
+        size_t first = runs.size();
+        int64_t others = INT64_MAX;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            if (runs[i].next == runs[i].end) {
+                continue;
+            }
+            int64_t micros = records[runs[i].next].micros;
+            if (first == runs.size() || micros < records[runs[first].next].micros) {
+                if (first != runs.size()) {
+                    others = std::min(others, records[runs[first].next].micros);
+                }
+                first = i;
+            } else {
+                others = std::min(others, micros);
+            }
+        }
+        if (first == runs.size()) {
+            break;
+        }
+        Run& run = runs[first];
+        const char* data = records[run.next].data;
+        int len = records[run.next].len;
+        for (++run.next; run.next < run.end && records[run.next].micros <= others; ++run.next) {
+            const Record& record = records[run.next];
+            if (record.data != data + len) {
+                write(output, data, len);
+                data = record.data;
+                len = 0;
+            }
+            len += record.len;
+        }
+        write(output, data, len);
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->released.store(released[i], std::memory_order_release);
+    }
+    if (!exited.empty()) {
+        fishnet::MutexLockGuard lock(mutex_);
+        for (ThreadBuffers* buffers : exited) {
+            auto it = std::find_if(threadBuffers_.begin(), threadBuffers_.end(),
+                                   [buffers](const std::unique_ptr<ThreadBuffers>& item) {
+                                       return item.get() == buffers;
+                                   });
+            assert(it != threadBuffers_.end());
+            threadBuffers_.erase(it);
+        }
+    }
+    if (overflowPolicy_ == OverflowPolicy::kBlock) {
+        fishnet::MutexLockGuard lock(mutex_);
+        notFull_.notifyAll();
+    }
+}
+
 void AsyncLogging::threadFunc() {
     assert(running_ == true);
+    if (overflowPolicy_ == OverflowPolicy::kSpill) {
+        // appended to by the threads in per-thread mode
+        spillFile_.reset(new LogFile(basename_ + ".spill", rollSize_, true));
+    }
     latch_.countDown();
     LogFile output(basename_, rollSize_, false);
+    if (perThreadBuffers_) {
+        int64_t dropped = 0;
+        int64_t spilled = 0;
+        bool stopping = false;
+        while (!stopping) {
+            stopping = !running_;
+            {
+                fishnet::MutexLockGuard lock(mutex_);
+                if (!segmentSealed_ && !stopping) {
+                    cond_.waitForSeconds(flushInterval_);
+                }
+                segmentSealed_ = false;
+            }
+            harvest(&output);
+            int64_t bytes = total(droppedBytes_, kNumLevels);
+            if (bytes > dropped) {
+                report(&output, "Dropped", bytes - dropped);
+                dropped = bytes;
+            }
+            bytes = total(spilledBytes_, kNumLevels);
+            if (bytes > spilled) {
+                report(&output, "Spilled", bytes - spilled);
+                spilled = bytes;
+                spillFile_->flush();
+            }
+            output.flush();
+        }
+        return;
+    }
     BufferPtr newBuffer1(new Buffer);
     BufferPtr newBuffer2(new Buffer);
     newBuffer1->bzero();
     newBuffer2->bzero();
     BufferVector buffersToWrite;
     buffersToWrite.reserve(16);
-    while (running_) {
+    // one more pass once stopped, for what was appended meanwhile
+    bool stopping = false;
+    while (!stopping) {
+        stopping = !running_;
         assert(newBuffer1 && newBuffer1->length() == 0);
         assert(newBuffer2 && newBuffer2->length() == 0);
         assert(buffersToWrite.empty());
         {
             fishnet::MutexLockGuard lock(mutex_);
-            if (buffers_.empty()) {
+            if (buffers_.empty() && !stopping) {
                 cond_.waitForSeconds(flushInterval_);
             }
             buffers_.push_back(std::move(currentBuffer_));
@@ -66,23 +594,41 @@ void AsyncLogging::threadFunc() {
             if (!nextBuffer_) {
                 nextBuffer_ = std::move(newBuffer2);
             }
+            if (overflowPolicy_ == OverflowPolicy::kBlock) {
+                notFull_.notifyAll();
+            }
         }
 
         assert(!buffersToWrite.empty());
-        if (buffersToWrite.size() > 25) {
+        // kBlock and kDropBySeverity bound the backlog in append()
+        if (buffersToWrite.size() > kMaxBuffers &&
+            (overflowPolicy_ == OverflowPolicy::kDrop ||
+             overflowPolicy_ == OverflowPolicy::kSpill)) {
             char buf[256];
-            snprintf(buf, sizeof(buf),
-                     "Dropped log messages at %s, %zd larger buffers\n",
+            snprintf(buf, sizeof(buf), "%s log messages at %s, %zd larger buffers\n",
+                     overflowPolicy_ == OverflowPolicy::kSpill ? "Spilled" : "Dropped",
                      Timestamp::now().toFormattedString().c_str(),
                      buffersToWrite.size() - 2);
             fputs(buf, stderr);
             output.append(buf, static_cast<int>(strlen(buf)));
+            for (size_t i = 2; i < buffersToWrite.size(); ++i) {
+                const Buffer& buffer = *buffersToWrite[i];
+                if (overflowPolicy_ == OverflowPolicy::kSpill) {
+                    spillFile_->append(buffer.data(), buffer.length());
+                    count(spilledBytes_, buffer.data(), buffer.length());
+                } else {
+                    count(droppedBytes_, buffer.data(), buffer.length());
+                }
+            }
+            if (overflowPolicy_ == OverflowPolicy::kSpill) {
+                spillFile_->flush();
+            }
             buffersToWrite.erase(buffersToWrite.begin() + 2,
                                  buffersToWrite.end());
         }
 
         for (const auto& buffer : buffersToWrite) {
-            output.append(buffer->data(), buffer->length());
+            write(&output, buffer->data(), buffer->length());
         }
 
         if (buffersToWrite.size() > 2) {
@@ -106,5 +652,4 @@ void AsyncLogging::threadFunc() {
         buffersToWrite.clear();
         output.flush();
     }
-    output.flush();
-}
\ No newline at end of file
+}
@@ -1,25 +1,90 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
+#include <memory>
 #include <vector>
 
 #include "fishnet/base/blocking_queue.h"
 #include "fishnet/base/bounded_blocking_queue.h"
 #include "fishnet/base/countdown_latch.h"
 #include "fishnet/base/log_stream.h"
+#include "fishnet/base/logging.h"
 #include "fishnet/base/mutex.h"
 #include "fishnet/base/thread.h"
+#include "fishnet/base/thread_local.h"
 
 namespace fishnet {
 
+class LogFile;
+
 class AsyncLogging : noncopyable {
 public:
+    /// What becomes of a line appended while the backend is behind, that is
+    /// with kMaxBuffers buffers, or a full ring of a thread, waiting for it.
+    enum class OverflowPolicy {
+        kDrop,            // the backlog but its oldest buffers, the default
+        kBlock,           // wait for the backend, for blockTimeout at most
+        kSpill,           // write the backlog to a file of its own instead
+        kDropBySeverity,  // lines below WARN, some room is kept for the rest
+    };
+
     AsyncLogging(const string& basename, off_t rollSize, int flushInterval = 3);
 
-    ~AsyncLogging() {
-        if (running_) {
-            stop();
-        }
+    ~AsyncLogging();
+
+    /// Each thread appends to a ring of buffers of its own without taking a
+    /// lock, instead of to the buffer shared under mutex_. The backend
+    /// harvests the rings and writes the lines of every pass in timestamp
+    /// order. What a thread whose ring is full does with its lines is up to
+    /// the OverflowPolicy.
+    /// Must be called before start()
+    void setPerThreadBuffers(bool on) {
+        perThreadBuffers_ = on;
+    }
+
+    /// The ring of a thread is up to @c segments segments of @c segmentSize
+    /// bytes, allocated as they are first used, kDefaultThreadSegments of
+    /// kDefaultSegmentSize by default. It bounds the burst a thread can log
+    /// ahead of the backend before the OverflowPolicy applies. A line longer
+    /// than a segment is dropped. The ring is freed once the thread exits
+    /// and the backend has written it.
+    /// Must be called before start()
+    void setThreadBufferSize(int segmentSize, int segments) {
+        assert(segmentSize >= fishnet::detail::kSmallBuffer && segments >= 2);
+        segmentSize_ = segmentSize;
+        threadSegments_ = segments;
+    }
+
+    /// Lines the backend has no room for are dropped by default, spill
+    /// writes them to basename.spill.*.log.
+    /// Must be called before start()
+    void setOverflowPolicy(OverflowPolicy policy) {
+        overflowPolicy_ = policy;
+    }
+
+    /// How long append() waits for room under OverflowPolicy::kBlock before
+    /// it drops the line after all.
+    /// Must be called before start()
+    void setBlockTimeout(double seconds) {
+        blockTimeout_ = seconds;
+    }
+
+    /// The lines are binary records of Logger::setBinary(), the backend
+    /// formats them as it writes them. Spilled ones are left as they are.
+    /// Must be called before start()
+    void setFormatRecords(bool on) {
+        formatRecords_ = on;
+    }
+
+    /// Bytes of lines of @c level dropped or spilled so far. The level is
+    /// parsed from the line or record as Logger makes it, other lines count
+    /// as INFO.
+    int64_t droppedBytes(Logger::LogLevel level) const {
+        return droppedBytes_[static_cast<size_t>(level)].load(std::memory_order_relaxed);
+    }
+    int64_t spilledBytes(Logger::LogLevel level) const {
+        return spilledBytes_[static_cast<size_t>(level)].load(std::memory_order_relaxed);
     }
 
     void append(const char* logline, int len);
@@ -33,11 +98,34 @@ public:
     void stop() NO_THREAD_SAFETY_ANALYSIS {
         running_ = false;
         cond_.notify();
+        notFull_.notifyAll();
         thread_.join();
     }
 
+    static const int kDefaultSegmentSize = 16 * fishnet::detail::kSmallBuffer;
+    static const int kDefaultThreadSegments = 32;
+
 private:
+    struct Segment;
+    struct ThreadBuffers;
+    struct RingOwner;
+
+    static const size_t kNumLevels = static_cast<size_t>(Logger::LogLevel::NUM_LOG_LEVELS);
+    // buffers waiting for the backend before append() overflows
+    static const size_t kMaxBuffers = 25;
+
     void threadFunc();
+    // whether the line may go on past kMaxBuffers buffers
+    bool admitOverflow(const char* logline, int len) REQUIRES(mutex_);
+    void appendToThreadBuffers(const char* logline, int len);
+    // whether the line may go on while the ring is full, when blocking
+    // until it isn't
+    bool admitOverflow(ThreadBuffers* buffers, const char* logline, int len);
+    ThreadBuffers* threadBuffers();
+    // writes what the threads committed
+    void harvest(LogFile* output);
+    void write(LogFile* output, const char* data, int len);
+    void count(std::atomic<int64_t>* counters, const char* data, int len);
 
     using Buffer = fishnet::detail::FixedBuffer<fishnet::detail::kLargerBuffer>;
     using BufferVector = std::vector<std::unique_ptr<Buffer>>;
@@ -51,9 +139,27 @@ private:
     CountDownLatch latch_;
     MutexLock mutex_;
     Condition cond_ GUARDED_BY(mutex_);
+    Condition notFull_ GUARDED_BY(mutex_);
     BufferPtr currentBuffer_ GUARDED_BY(mutex_);
     BufferPtr nextBuffer_ GUARDED_BY(mutex_);
     BufferVector buffers_ GUARDED_BY(mutex_);
+
+    bool perThreadBuffers_;
+    const int64_t id_;  // tells instances apart in the thread local cache
+    int segmentSize_;
+    int threadSegments_;
+    std::vector<std::unique_ptr<ThreadBuffers>> threadBuffers_ GUARDED_BY(mutex_);
+    ThreadLocal<RingOwner> ringOwners_;
+    bool segmentSealed_ GUARDED_BY(mutex_);
+
+    OverflowPolicy overflowPolicy_;
+    double blockTimeout_;
+    std::unique_ptr<LogFile> spillFile_;
+    std::atomic<int64_t> droppedBytes_[kNumLevels];
+    std::atomic<int64_t> spilledBytes_[kNumLevels];
+
+    bool formatRecords_;
+    string formatted_;  // backend only
 };
 
 }  // namespace fishnet
\ No newline at end of file
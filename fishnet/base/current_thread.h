@@ -34,6 +34,10 @@ bool isMainThread();
 
 void sleepUsec(int64_t usec);
 
+/// Pins the calling thread to one CPU.
+/// @return false, with errno set, if the CPU isn't available
+bool setCpuAffinity(int cpu);
+
 string stackTrace(bool demangle);
 
 }  // namespace current_thread
@@ -0,0 +1,233 @@
+#include "fishnet/base/log_record.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "fishnet/base/log_stream.h"
+#include "fishnet/base/logging.h"
+
+namespace fishnet {
+extern const char* LogLevelName[];
+StringPiece formatLogTime(int64_t microSecondsSinceEpoch);
+}  // namespace fishnet
+
+using namespace fishnet;
+using namespace fishnet::log_record;
+
+namespace {
+
+class Reader {
+public:
+    Reader(const char* data, const char* end) : cur_(data), end_(end) {}
+
+    template <typename T>
+    bool read(T* value) {
+        if (static_cast<size_t>(end_ - cur_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(value, cur_, sizeof(T));
+        cur_ += sizeof(T);
+        return true;
+    }
+
+    bool read(size_t len, StringPiece* bytes) {
+        if (static_cast<size_t>(end_ - cur_) < len) {
+            return false;
+        }
+        bytes->set(cur_, static_cast<int>(len));
+        cur_ += len;
+        return true;
+    }
+
+    const char* current() const {
+        return cur_;
+    }
+
+private:
+    const char* cur_;
+    const char* const end_;
+};
+
+enum class Status {
+    kComplete,
+    kIncomplete,  // cut off
+    kBad,
+};
+
+struct Header {
+    uint8_t level;
+    int32_t tid;
+    int64_t micros;
+    int32_t savedErrno;
+    int32_t line;
+    StringPiece file;
+};
+
+Status readHeader(Reader* reader, Header* header) {
+    char magic = 0;
+    uint8_t fileLen = 0;
+    if (!reader->read(&magic) || !reader->read(&header->level) ||
+        !reader->read(&header->tid) || !reader->read(&header->micros) ||
+        !reader->read(&header->savedErrno) || !reader->read(&header->line) ||
+        !reader->read(&fileLen) || !reader->read(fileLen, &header->file)) {
+        return Status::kIncomplete;
+    }
+    assert(magic == kMagic);
+    if (header->level >= static_cast<uint8_t>(Logger::LogLevel::NUM_LOG_LEVELS)) {
+        return Status::kBad;
+    }
+    return Status::kComplete;
+}
+
+template <typename T>
+Status readArg(Reader* reader, LogStream* stream) {
+    T value;
+    if (!reader->read(&value)) {
+        return Status::kIncomplete;
+    }
+    if (stream != NULL) {
+        *stream << value;
+    }
+    return Status::kComplete;
+}
+
+// the arguments up to kEnd, formatted into @c stream if not NULL
+Status readArgs(Reader* reader, LogStream* stream) {
+    for (;;) {
+        char tag = kEnd;
+        if (!reader->read(&tag)) {
+            return Status::kIncomplete;
+        }
+        Status status = Status::kComplete;
+        switch (tag) {
+            case kEnd:
+                return Status::kComplete;
+            case kInt32:
+                status = readArg<int32_t>(reader, stream);
+                break;
+            case kUint32:
+                status = readArg<uint32_t>(reader, stream);
+                break;
+            case kInt64:
+                status = readArg<long long>(reader, stream);
+                break;
+            case kUint64:
+                status = readArg<unsigned long long>(reader, stream);
+                break;
+            case kDouble:
+                status = readArg<double>(reader, stream);
+                break;
+            case kChar:
+                status = readArg<char>(reader, stream);
+                break;
+            case kPointer: {
+                uint64_t value = 0;
+                if (!reader->read(&value)) {
+                    return Status::kIncomplete;
+                }
+                if (stream != NULL) {
+                    *stream << reinterpret_cast<const void*>(static_cast<uintptr_t>(value));
+                }
+                break;
+            }
+            case kString: {
+                uint16_t len = 0;
+                StringPiece bytes;
+                if (!reader->read(&len) || !reader->read(len, &bytes)) {
+                    return Status::kIncomplete;
+                }
+                if (stream != NULL) {
+                    *stream << bytes;
+                }
+                break;
+            }
+            default:
+                return Status::kBad;
+        }
+        if (status != Status::kComplete) {
+            return status;
+        }
+    }
+}
+
+Status read(const char* data, const char* end, LogStream* stream, Header* header,
+            const char** next) {
+    Reader reader(data, end);
+    Status status = readHeader(&reader, header);
+    if (status != Status::kComplete) {
+        return status;
+    }
+    if (stream != NULL) {
+        *stream << formatLogTime(header->micros);
+        char tid[32];
+        int len = snprintf(tid, sizeof(tid), "%5d ", header->tid);
+        stream->append(tid, len);
+        stream->append(LogLevelName[header->level], 6);
+        if (header->savedErrno != 0) {
+            *stream << strerror_tl(header->savedErrno) << " (errno=" << header->savedErrno
+                    << ") ";
+        }
+    }
+    status = readArgs(&reader, stream);
+    if (status == Status::kComplete && stream != NULL) {
+        *stream << " - " << header->file << ':' << header->line << '\n';
+    }
+    *next = reader.current();
+    return status;
+}
+
+}  // namespace
+
+size_t log_record::length(const char* data, size_t len) {
+    if (len == 0 || data[0] != kMagic) {
+        return 0;
+    }
+    Header header;
+    const char* next = data;
+    if (read(data, data + len, NULL, &header, &next) != Status::kComplete) {
+        return 0;
+    }
+    return static_cast<size_t>(next - data);
+}
+
+int log_record::level(const char* data, size_t len) {
+    if (len < kHeaderLen || data[0] != kMagic) {
+        return -1;
+    }
+    return static_cast<uint8_t>(data[1]);
+}
+
+size_t log_record::format(const char* data, size_t len, string* out) {
+    const char* p = data;
+    const char* const end = data + len;
+    LogStream stream;
+    while (p < end) {
+        if (*p != kMagic) {
+            // a line of text, from AsyncLogging say
+            const void* eol = memchr(p, '\n', static_cast<size_t>(end - p));
+            if (eol == NULL) {
+                break;
+            }
+            const char* next = static_cast<const char*>(eol) + 1;
+            out->append(p, next);
+            p = next;
+            continue;
+        }
+        Header header;
+        const char* next = p;
+        stream.resetBuffer();
+        Status status = read(p, end, &stream, &header, &next);
+        if (status == Status::kIncomplete) {
+            break;
+        } else if (status == Status::kBad) {
+            // skip to what may be the next record
+            const void* magic = memchr(p + 1, kMagic, static_cast<size_t>(end - p - 1));
+            next = magic == NULL ? end : static_cast<const char*>(magic);
+        } else {
+            out->append(stream.buffer().data(), static_cast<size_t>(stream.buffer().length()));
+        }
+        p = next;
+    }
+    return static_cast<size_t>(p - data);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fishnet/base/types.h"
+
+namespace fishnet {
+
+///
+/// Binary log records, what LOG_* hand the output with Logger::setBinary().
+///
+/// Recording the arguments of a line as they are instead of formatting them
+/// takes the formatting off the thread logging, to the AsyncLogging backend
+/// or an offline decoder. A record is
+///
+///   kMagic, level u8, tid i32, microseconds since epoch i64, errno i32,
+///   line i32, length of the file basename u8 and the basename,
+///   then each argument as a tag and its value, then kEnd
+///
+/// in host byte order, unaligned. A kString is an u16 length and the bytes.
+/// Formatted, a record reads as the line Logger writes in text mode.
+namespace log_record {
+
+const char kMagic = '\x1e';
+
+enum Tag : char {
+    kEnd,
+    kInt32,
+    kUint32,
+    kInt64,
+    kUint64,
+    kDouble,
+    kChar,
+    kPointer,
+    kString,
+};
+
+/// The bytes before the basename.
+const size_t kHeaderLen = 1 + 1 + 4 + 8 + 4 + 4 + 1;
+
+/// The length of the record at @c data, 0 if there's no whole record.
+size_t length(const char* data, size_t len);
+
+/// The level of the record at @c data, -1 if it isn't one.
+int level(const char* data, size_t len);
+
+/// Appends to @c out the records in [data, data + len) formatted, and the
+/// text lines among them as they are.
+/// @return the bytes consumed, short of a record or line cut off at the end
+size_t format(const char* data, size_t len, string* out);
+
+}  // namespace log_record
+}  // namespace fishnet
@@ -223,38 +223,64 @@ LogStream& LogStream::operator<<(unsigned short v) {
 }
 
 LogStream& LogStream::operator<<(int v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kInt32, static_cast<int32_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned int v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kUint32, static_cast<uint32_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(long v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kInt64, static_cast<int64_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned long v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kUint64, static_cast<uint64_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(long long v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kInt64, static_cast<int64_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned long long v) {
-    formatInteger(v);
+    if (binary_) {
+        appendArg(log_record::kUint64, static_cast<uint64_t>(v));
+    } else if (beginText()) {
+        formatInteger(v);
+    }
     return *this;
 }
 
 LogStream& LogStream::operator<<(const void* p) {
     uintptr_t v = reinterpret_cast<uintptr_t>(p);
-    if (buffer_.avail() >= kMaxNumericSize) {
+    if (binary_) {
+        appendArg(log_record::kPointer, static_cast<uint64_t>(v));
+    } else if (beginText() && buffer_.avail() >= kMaxNumericSize) {
         char* buf = buffer_.current();
         buf[0] = '0';
         buf[1] = 'x';
@@ -265,13 +291,171 @@ LogStream& LogStream::operator<<(const void* p) {
 }
 
 LogStream& LogStream::operator<<(double v) {
-    if (buffer_.avail() >= kMaxNumericSize) {
+    if (binary_) {
+        appendArg(log_record::kDouble, v);
+    } else if (beginText() && buffer_.avail() >= kMaxNumericSize) {
         int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
         buffer_.add(len);
     }
     return *this;
 }
 
+void LogStream::beginRecord(int level, int tid, int64_t microSecondsSinceEpoch,
+                            int savedErrno, const char* file, int fileLen, int line) {
+    assert(binary_ && buffer_.length() == 0);
+    const uint8_t len = static_cast<uint8_t>(std::min(fileLen, 255));
+    char header[log_record::kHeaderLen];
+    char* p = header;
+    *p++ = log_record::kMagic;
+    *p++ = static_cast<char>(level);
+    const int32_t tid32 = tid;
+    const int32_t errno32 = savedErrno;
+    const int32_t line32 = line;
+    memcpy(p, &tid32, sizeof(tid32));
+    p += sizeof(tid32);
+    memcpy(p, &microSecondsSinceEpoch, sizeof(microSecondsSinceEpoch));
+    p += sizeof(microSecondsSinceEpoch);
+    memcpy(p, &errno32, sizeof(errno32));
+    p += sizeof(errno32);
+    memcpy(p, &line32, sizeof(line32));
+    p += sizeof(line32);
+    *p++ = static_cast<char>(len);
+    assert(p == header + sizeof(header));
+    buffer_.append(header, sizeof(header));
+    buffer_.append(file, len);
+}
+
+void LogStream::appendBinaryString(const char* data, size_t len) {
+    // all or nothing as FixedBuffer::append(), leaving room for kEnd
+    const size_t kOverhead = 1 + sizeof(uint16_t) + 1;
+    if (static_cast<size_t>(buffer_.avail()) <= kOverhead + len) {
+        return;
+    }
+    const uint16_t n = static_cast<uint16_t>(len);
+    char* p = buffer_.current();
+    *p = log_record::kString;
+    memcpy(p + 1, &n, sizeof(n));
+    memcpy(p + 1 + sizeof(n), data, n);
+    buffer_.add(1 + sizeof(n) + n);
+}
+
+void LogStream::beginJsonLine(const StringPiece& time, int tid, const StringPiece& level) {
+    assert(json_ && buffer_.length() == 0);
+    appendRaw("{\"time\":\"");
+    buffer_.append(time.data(), static_cast<size_t>(time.size()));
+    appendRaw("\",\"tid\":");
+    formatInteger(tid);
+    appendRaw(",\"level\":\"");
+    buffer_.append(level.data(), static_cast<size_t>(level.size()));
+    appendRaw("\"");
+}
+
+void LogStream::endJsonLine(const StringPiece& file, int line) {
+    assert(json_ && !inField_);
+    if (inMessage_) {
+        appendRaw("\"");
+        inMessage_ = false;
+    }
+    appendRaw(",\"src\":\"");
+    // out of kJsonReserve, short of what follows
+    appendEscaped(file.data(), static_cast<size_t>(file.size()), kMaxNumericSize + 8);
+    appendRaw(":");
+    formatInteger(line);
+    appendRaw("\"}\n");
+}
+
+bool LogStream::beginField(const StringPiece& key) {
+    if (json_) {
+        // the key is cut short of room for a number after it, so the value
+        // isn't dropped by beginText() and the field stays valid JSON
+        const int valueRoom = kMaxNumericSize + kJsonReserve;
+        if (buffer_.avail() <= valueRoom + 5) {
+            return false;
+        }
+        if (inMessage_) {
+            appendRaw("\"");
+            inMessage_ = false;
+        }
+        appendRaw(",\"");
+        appendEscaped(key.data(), static_cast<size_t>(key.size()), valueRoom + 3);
+        appendRaw("\":");
+        assert(buffer_.avail() > valueRoom);
+    } else {
+        appendString(key.data(), static_cast<size_t>(key.size()));
+        *this << '=';
+    }
+    inField_ = true;
+    return true;
+}
+
+void LogStream::endField() {
+    inField_ = false;
+    if (!json_) {
+        *this << ' ';
+    }
+}
+
+void LogStream::appendFieldString(const char* data, size_t len) {
+    if (json_) {
+        appendRaw("\"");
+        appendEscaped(data, len);
+        appendRaw("\"");
+    } else {
+        appendString(data, len);
+    }
+}
+
+void LogStream::appendEscaped(const char* data, size_t len, int reserve) {
+    static const char kHex[] = "0123456789abcdef";
+    int room = buffer_.avail() - reserve;
+    if (room <= 0) {
+        return;
+    }
+    char* p = buffer_.current();
+    char* const limit = p + room;
+    const char* const end = data + len;
+    while (data < end) {
+        // the run that needs no escaping at once
+        const char* run = data;
+        while (run < end && static_cast<unsigned char>(*run) >= 0x20 && *run != '"' &&
+               *run != '\\') {
+            ++run;
+        }
+        size_t n = std::min(static_cast<size_t>(run - data), static_cast<size_t>(limit - p));
+        memcpy(p, data, n);
+        p += n;
+        data += n;
+        if (data == end || data < run || limit - p < 6) {
+            break;
+        }
+        const char c = *data++;
+        *p++ = '\\';
+        switch (c) {
+            case '"':
+            case '\\':
+                *p++ = c;
+                break;
+            case '\n':
+                *p++ = 'n';
+                break;
+            case '\r':
+                *p++ = 'r';
+                break;
+            case '\t':
+                *p++ = 't';
+                break;
+            default:
+                *p++ = 'u';
+                *p++ = '0';
+                *p++ = '0';
+                *p++ = kHex[(c >> 4) & 0xf];
+                *p++ = kHex[c & 0xf];
+                break;
+        }
+    }
+    buffer_.add(static_cast<size_t>(p - buffer_.current()));
+}
+
 template <typename T>
 Fmt::Fmt(const char* fmt, T val) {
     static_assert(std::is_arithmetic<T>::value == true,
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <cstring>
+#include <type_traits>
 
+#include "fishnet/base/log_record.h"
 #include "fishnet/base/noncopyable.h"
 #include "fishnet/base/string_piece.h"
 #include "fishnet/base/types.h"
@@ -88,8 +91,10 @@ class LogStream : noncopyable {
 public:
     using Buffer = detail::FixedBuffer<detail::kSmallBuffer>;
 
+    LogStream() : binary_(false), json_(false), inMessage_(false), inField_(false) {}
+
     self& operator<<(bool v) {
-        buffer_.append(v ? "1" : "0", 1);
+        *this << (v ? '1' : '0');
         return *this;
     }
 
@@ -112,15 +117,19 @@ public:
     self& operator<<(double);
 
     self& operator<<(char v) {
-        buffer_.append(&v, 1);
+        if (binary_) {
+            appendArg(log_record::kChar, v);
+        } else {
+            appendString(&v, 1);
+        }
         return *this;
     }
 
     self& operator<<(const char* str) {
         if (str) {
-            buffer_.append(str, strlen(str));
+            appendString(str, strlen(str));
         } else {
-            buffer_.append("(null)", 6);
+            appendString("(null)", 6);
         }
         return *this;
     }
@@ -130,12 +139,12 @@ public:
     }
 
     self& operator<<(const string& v) {
-        buffer_.append(v.c_str(), v.size());
+        appendString(v.c_str(), v.size());
         return *this;
     }
 
     self& operator<<(const StringPiece& v) {
-        buffer_.append(v.data(), v.size());
+        appendString(v.data(), static_cast<size_t>(v.size()));
         return *this;
     }
 
@@ -145,8 +154,56 @@ public:
     }
 
     void append(const char* data, int len) {
-        buffer_.append(data, len);
+        appendString(data, static_cast<size_t>(len));
+    }
+    /// A field of the line, key=value in text, "key":value in a JSON line,
+    /// so that what reads the log needn't parse the message for it:
+    ///
+    ///   LOG_INFO.kv("conn", conn->name()).kv("bytes", n) << "read";
+    ///
+    /// In text the fields read best before the message.
+    self& kv(const StringPiece& key, const StringPiece& value) {
+        if (beginField(key)) {
+            appendFieldString(value.data(), static_cast<size_t>(value.size()));
+            endField();
+        }
+        return *this;
+    }
+    self& kv(const StringPiece& key, const char* value) {
+        return kv(key, StringPiece(value ? value : "(null)"));
+    }
+    self& kv(const StringPiece& key, const string& value) {
+        return kv(key, StringPiece(value));
+    }
+    self& kv(const StringPiece& key, char value) {
+        return kv(key, StringPiece(&value, 1));
     }
+    self& kv(const StringPiece& key, bool value) {
+        if (beginField(key)) {
+            if (json_) {
+                appendRaw(value ? "true" : "false");
+            } else {
+                *this << value;
+            }
+            endField();
+        }
+        return *this;
+    }
+    template <typename T>
+    self& kv(const StringPiece& key, T value) {
+        static_assert(std::is_arithmetic<T>::value, "a number, string or bool");
+        if (beginField(key)) {
+            if (json_ && std::is_floating_point<T>::value &&
+                !std::isfinite(static_cast<double>(value))) {
+                appendRaw("null");
+            } else {
+                *this << value;
+            }
+            endField();
+        }
+        return *this;
+    }
+
     const Buffer& buffer() const {
         return buffer_;
     }
@@ -154,13 +211,89 @@ public:
         buffer_.reset();
     }
 
+    /// Records what is streamed tagged with its type instead of formatting
+    /// it, between beginRecord() and endRecord(), see log_record.h.
+    void setBinary(bool on) {
+        binary_ = on;
+    }
+    bool binary() const {
+        return binary_;
+    }
+    void beginRecord(int level, int tid, int64_t microSecondsSinceEpoch, int savedErrno,
+                     const char* file, int fileLen, int line);
+    void endRecord() {
+        // appendArg() left room for it
+        char end = log_record::kEnd;
+        buffer_.append(&end, 1);
+    }
+
+    /// Makes the line a JSON object, between beginJsonLine() and
+    /// endJsonLine(). What is streamed is its "msg", escaped.
+    void setJson(bool on) {
+        json_ = on;
+    }
+    bool json() const {
+        return json_;
+    }
+    void beginJsonLine(const StringPiece& time, int tid, const StringPiece& level);
+    void endJsonLine(const StringPiece& file, int line);
+
 private:
     void staticCheck();
     template <typename T>
     void formatInteger(T);
+    template <typename T>
+    void appendArg(log_record::Tag tag, T v) {
+        // and room for kEnd
+        if (static_cast<size_t>(buffer_.avail()) > 1 + sizeof(v) + 1) {
+            char* p = buffer_.current();
+            *p = tag;
+            memcpy(p + 1, &v, sizeof(v));
+            buffer_.add(1 + sizeof(v));
+        }
+    }
+    void appendString(const char* data, size_t len) {
+        if (binary_) {
+            appendBinaryString(data, len);
+        } else if (json_) {
+            if (beginText()) {
+                appendEscaped(data, len);
+            }
+        } else {
+            buffer_.append(data, len);
+        }
+    }
+    void appendBinaryString(const char* data, size_t len);
+    void appendRaw(const char* str) {
+        buffer_.append(str, strlen(str));
+    }
+    // opens the "msg" of a JSON line if need be, @return if there's room
+    // for a number
+    bool beginText() {
+        if (!json_) {
+            return true;
+        }
+        if (!inMessage_ && !inField_) {
+            appendRaw(",\"msg\":\"");
+            inMessage_ = true;
+        }
+        return buffer_.avail() > kMaxNumericSize + kJsonReserve;
+    }
+    // @return false if a JSON line has no room left for it
+    bool beginField(const StringPiece& key);
+    void endField();
+    void appendFieldString(const char* data, size_t len);
+    // as much of it as fits short of @c reserve
+    void appendEscaped(const char* data, size_t len, int reserve = kJsonReserve);
 
     Buffer buffer_;
+    bool binary_;
+    bool json_;
+    bool inMessage_;  // of a JSON line
+    bool inField_;
     static const int kMaxNumericSize = 32;
+    // kept for closing a JSON line
+    static const int kJsonReserve = 320;
 };
 
 class Fmt {
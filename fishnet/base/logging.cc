@@ -13,7 +13,9 @@ namespace fishnet {
 
 __thread char t_errnobuf[512];
 __thread char t_time[64];
+__thread int t_timeLength;
 __thread time_t t_lastSecond;
+__thread bool t_lastZoned;
 
 const char* strerror_tl(int savedErrno) {
     return strerror_r(savedErrno, t_errnobuf, sizeof(t_errnobuf));
@@ -30,6 +32,9 @@ Logger::LogLevel initLogLevel() {
 }
 
 Logger::LogLevel g_logLevel = initLogLevel();
+bool g_logBinary = false;
+bool g_logCoarseClock = false;
+bool g_logJson = false;
 
 const char*
     LogLevelName[static_cast<size_t>(Logger::LogLevel::NUM_LOG_LEVELS)] = {
@@ -69,17 +74,67 @@ Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
 TimeZone g_logTimeZone;
 
+// t_time keeps the line's time but for the microseconds, only those are
+// written unless the second has changed. @return it with a trailing space
+StringPiece formatLogTime(int64_t microSecondsSinceEpoch) {
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch /
+                                         Timestamp::KMicroSecondsPerSecond);
+    int microseconds = static_cast<int>(microSecondsSinceEpoch %
+                                        Timestamp::KMicroSecondsPerSecond);
+    const bool zoned = g_logTimeZone.valid();
+    if (seconds != t_lastSecond || zoned != t_lastZoned) {
+        t_lastSecond = seconds;
+        t_lastZoned = zoned;
+        struct tm tm_time;
+        if (zoned) {
+            tm_time = g_logTimeZone.toLocalTime(seconds);
+        } else {
+            ::gmtime_r(&seconds, &tm_time);
+        }
+        int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d%s",
+                           tm_time.tm_year + 1900, tm_time.tm_mon + 1,
+                           tm_time.tm_mday, tm_time.tm_hour, tm_time.tm_min,
+                           tm_time.tm_sec, zoned ? ".000000 " : ".000000Z ");
+        assert(len == (zoned ? 25 : 26));
+        t_timeLength = len;
+    }
+    char* us = t_time + 18;
+    for (int i = 5; i >= 0; --i) {
+        us[i] = static_cast<char>('0' + microseconds % 10);
+        microseconds /= 10;
+    }
+    return StringPiece(t_time, t_timeLength);
+}
+
 }  // namespace fishnet
 
 using namespace fishnet;
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file,
                    int line)
-    : time_(Timestamp::now()),
+    : time_(g_logCoarseClock ? Timestamp::nowCoarse() : Timestamp::now()),
       stream_(),
       level_(level),
       line_(line),
       basename_(file) {
+    if (g_logBinary) {
+        stream_.setBinary(true);
+        stream_.beginRecord(static_cast<int>(level), current_thread::tid(),
+                            time_.microSecondsSinceEpoch(), savedErrno, basename_.data_,
+                            basename_.size_, line_);
+        return;
+    }
+    if (g_logJson) {
+        const char* name = LogLevelName[static_cast<size_t>(level)];
+        StringPiece time = formatLogTime(time_.microSecondsSinceEpoch());
+        stream_.setJson(true);
+        stream_.beginJsonLine(StringPiece(time.data(), time.size() - 1), current_thread::tid(),
+                              StringPiece(name, static_cast<int>(strcspn(name, " "))));
+        if (savedErrno != 0) {
+            stream_.kv("errno", savedErrno).kv("error", strerror_tl(savedErrno));
+        }
+        return;
+    }
     formatTime();
     // current_thread::tid();
     stream_ << T(current_thread::tidString(),
@@ -91,38 +146,19 @@ Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file,
 }
 
 void Logger::Impl::formatTime() {
-    int64_t microSecondsSinceEpoch = time_.microSecondsSinceEpoch();
-    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch /
-                                         Timestamp::KMicroSecondsPerSecond);
-    int microseconds = static_cast<int>(microSecondsSinceEpoch %
-                                        Timestamp::KMicroSecondsPerSecond);
-    if (seconds != t_lastSecond) {
-        t_lastSecond = seconds;
-        struct tm tm_time;
-        if (g_logTimeZone.valid()) {
-            tm_time = g_logTimeZone.toLocalTime(seconds);
-        } else {
-            ::gmtime_r(&seconds, &tm_time);
-        }
-        int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d",
-                           tm_time.tm_year + 1900, tm_time.tm_mon + 1,
-                           tm_time.tm_mday, tm_time.tm_hour, tm_time.tm_min,
-                           tm_time.tm_sec);
-        assert(len == 17);
-        (void)len;
-    }
-    if (g_logTimeZone.valid()) {
-        Fmt us(".%06d ", microseconds);
-        assert(us.length() == 8);
-        stream_ << T(t_time, 17) << T(us.data(), 8);
-    } else {
-        Fmt us(".%06dZ ", microseconds);
-        assert(us.length() == 9);
-        stream_ << T(t_time, 17) << T(us.data(), 9);
-    }
+    StringPiece time = formatLogTime(time_.microSecondsSinceEpoch());
+    stream_ << T(time.data(), static_cast<unsigned>(time.size()));
 }
 
 void Logger::Impl::finish() {
+    if (stream_.binary()) {
+        stream_.endRecord();
+        return;
+    }
+    if (stream_.json()) {
+        stream_.endJsonLine(StringPiece(basename_.data_, basename_.size_), line_);
+        return;
+    }
     stream_ << " - " << basename_ << ':' << line_ << '\n';
 }
 
@@ -131,7 +167,11 @@ Logger::Logger(SourceFile file, int line)
 
 Logger::Logger(SourceFile file, int line, LogLevel level, const char* func)
     : impl_(level, 0, file, line) {
-    impl_.stream_ << func << ' ';
+    if (impl_.stream_.json()) {
+        impl_.stream_.kv("func", func);
+    } else {
+        impl_.stream_ << func << ' ';
+    }
 }
 
 Logger::Logger(SourceFile file, int line, LogLevel level)
@@ -165,4 +205,16 @@ void Logger::setFlush(FlushFunc flush) {
 
 void Logger::setTimeZone(const TimeZone& tz) {
     g_logTimeZone = tz;
+}
+
+void Logger::setBinary(bool on) {
+    g_logBinary = on;
+}
+
+void Logger::setCoarseClock(bool on) {
+    g_logCoarseClock = on;
+}
+
+void Logger::setJsonLines(bool on) {
+    g_logJson = on;
 }
\ No newline at end of file
@@ -60,6 +60,17 @@ public:
     static void setOutput(OutputFunc);
     static void setFlush(FlushFunc);
     static void setTimeZone(const TimeZone& tz);
+    /// LOG_* hand the output binary records instead of text, leaving the
+    /// formatting to AsyncLogging::setFormatRecords() or log_decoder, see
+    /// log_record.h.
+    static void setBinary(bool on);
+    /// Lines are timed by Timestamp::nowCoarse() instead of now(), to the
+    /// tick of the kernel rather than to the microsecond.
+    static void setCoarseClock(bool on);
+    /// Each line is a JSON object of its time, tid, level, LogStream::kv()
+    /// fields, message and source, one per line, instead of free text.
+    /// Records of setBinary() take precedence.
+    static void setJsonLines(bool on);
 
 private:
     class Impl {
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/base/object_pool.h"
+
+namespace fishnet {
+
+///
+/// Unbounded lock-free queue, many producers and a single consumer.
+///
+/// Dmitry Vyukov's intrusive MPSC queue: push() is one atomic exchange plus
+/// a store, pop() touches no shared counter but the optional size. Each
+/// element lives in a node push() takes from the FixedSizePool of its
+/// thread, pop() gives it back to the pool of the consumer, and the consumer
+/// keeps the last popped node as the stub. Nodes pushed and popped in one
+/// thread, or traded between two, are recycled without malloc.
+///
+/// pop() may report empty while a producer is between its exchange and the
+/// link store, callers must retry after the producer's own notification.
+template <typename T>
+class MpscQueue : noncopyable {
+public:
+    MpscQueue() : head_(newNode(T())), tail_(head_.load(std::memory_order_relaxed)), size_(0) {}
+
+    ~MpscQueue() {
+        T dropped;
+        while (pop(&dropped)) {
+        }
+        deleteNode(tail_);
+    }
+
+    /// Thread safe.
+    void push(T&& x) {
+        Node* node = newNode(std::move(x));
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+        size_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Must be called by the single consumer.
+    bool pop(T* x) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == NULL) {
+            return false;
+        }
+        *x = std::move(next->value);
+        // next becomes the stub, don't let it hold what x now owns
+        next->value = T();
+        tail_ = next;
+        deleteNode(tail);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Approximate when producers are running.
+    size_t size() const {
+        ptrdiff_t n = size_.load(std::memory_order_relaxed);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+
+private:
+    struct Node {
+        explicit Node(T&& x) : next(NULL), value(std::move(x)) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    using NodePool = FixedSizePool<sizeof(Node)>;
+
+    static Node* newNode(T&& x) {
+        void* p = NodePool::instance().allocate();
+        return new (p) Node(std::move(x));
+    }
+
+    static void deleteNode(Node* node) {
+        node->~Node();
+        NodePool::instance().deallocate(node);
+    }
+
+    std::atomic<Node*> head_;  // producers push here
+    Node* tail_;               // stub, owned by the consumer
+    std::atomic<ptrdiff_t> size_;
+};
+
+}  // namespace fishnet
\ No newline at end of file
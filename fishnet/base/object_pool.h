@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/base/thread_local_singleton.h"
+
+namespace fishnet {
+
+///
+/// Per thread free list of blocks of kSize bytes.
+///
+/// Blocks are plain malloc memory, one may be freed to the pool of another
+/// thread than the one it came from. Up to kMaxCached blocks are kept, the
+/// rest go back to malloc.
+///
+/// Not thread safe, use instance() of the calling thread.
+template <size_t kSize>
+class FixedSizePool : noncopyable {
+public:
+    static const size_t kMaxCached = 4096;
+
+    FixedSizePool() : freeList_(NULL), numCached_(0), numHits_(0), numMisses_(0) {}
+
+    ~FixedSizePool() {
+        while (freeList_ != NULL) {
+            Block* next = freeList_->next;
+            ::free(freeList_);
+            freeList_ = next;
+        }
+    }
+
+    /// The pool of the calling thread.
+    static FixedSizePool& instance() {
+        return ThreadLocalSingleton<FixedSizePool>::instance();
+    }
+
+    void* allocate() {
+        if (freeList_ != NULL) {
+            Block* block = freeList_;
+            freeList_ = block->next;
+            --numCached_;
+            ++numHits_;
+            return block;
+        }
+        ++numMisses_;
+        void* p = ::malloc(kSize < sizeof(Block) ? sizeof(Block) : kSize);
+        if (p == NULL) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void deallocate(void* p) {
+        if (numCached_ < kMaxCached) {
+            Block* block = static_cast<Block*>(p);
+            block->next = freeList_;
+            freeList_ = block;
+            ++numCached_;
+        } else {
+            ::free(p);
+        }
+    }
+
+    /// Allocations served from the free list.
+    int64_t numHits() const {
+        return numHits_;
+    }
+
+    /// Allocations that went to malloc.
+    int64_t numMisses() const {
+        return numMisses_;
+    }
+
+private:
+    struct Block {
+        Block* next;
+    };
+
+    Block* freeList_;
+    size_t numCached_;
+    int64_t numHits_;
+    int64_t numMisses_;
+};
+
+///
+/// Allocator drawing single objects from the FixedSizePool of the calling
+/// thread, for std::allocate_shared, so that the object and its control
+/// block are one recycled allocation. Arrays go to operator new.
+///
+/// Stateless, all instances are equal.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(FixedSizePool<sizeof(T)>::instance().allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n == 1) {
+            FixedSizePool<sizeof(T)>::instance().deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U>;
+    };
+};
+
+template <typename T, typename U>
+inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return false;
+}
+
+}  // namespace fishnet
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "fishnet/base/async_logging.h"
+#include "fishnet/base/countdown_latch.h"
+#include "fishnet/base/logging.h"
+#include "fishnet/base/thread.h"
+#include "fishnet/base/timestamp.h"
+
+using namespace fishnet;
+
+// Many threads logging through one AsyncLogging, the shared buffer under
+// mutex_ vs per-thread buffers. Writes async_logging_bench.*.log in the
+// working directory.
+//
+// usage: async_logging_bench [lines_per_thread]
+
+namespace {
+
+const off_t kRollSize = 500 * 1000 * 1000;
+
+AsyncLogging* g_asyncLog = NULL;
+
+void asyncOutput(const char* msg, int len) {
+    g_asyncLog->append(msg, len);
+}
+
+void bench(bool perThreadBuffers, int numThreads, int linesPerThread) {
+    AsyncLogging log{"async_logging_bench", kRollSize};
+    log.setPerThreadBuffers(perThreadBuffers);
+    log.start();
+    g_asyncLog = &log;
+
+    CountDownLatch start(1);
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(new Thread([&start, linesPerThread] {
+            start.wait();
+            for (int j = 0; j < linesPerThread; ++j) {
+                LOG_INFO << "TcpServer::newConnection [bench] - new connection [bench-" << j
+                         << "] from 127.0.0.1:" << 10000 + j % 50000;
+            }
+        }));
+        threads.back()->start();
+    }
+
+    Timestamp begin(Timestamp::now());
+    start.countDown();
+    for (auto& t : threads) {
+        t->join();
+    }
+    double seconds = timeDifference(Timestamp::now(), begin);
+    log.stop();
+    printf("%-18s %2d threads: %10.0f lines/s\n",
+           perThreadBuffers ? "per-thread buffers" : "shared buffer", numThreads,
+           static_cast<double>(numThreads) * linesPerThread / seconds);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int linesPerThread = argc > 1 ? atoi(argv[1]) : 100 * 1000;
+    Logger::setOutput(asyncOutput);
+    for (int n = 1; n <= 16; n *= 2) {
+        bench(false, n, linesPerThread);
+        bench(true, n, linesPerThread);
+    }
+}
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "fishnet/base/log_record.h"
+#include "fishnet/base/logging.h"
+#include "fishnet/base/timestamp.h"
+
+using namespace fishnet;
+
+// What a LOG_INFO line costs the thread logging it, formatted as text vs
+// recorded binary, and what formatting the records costs the backend.
+//
+// usage: binary_logging_bench [lines]
+
+namespace {
+
+string g_output;
+
+void keepOutput(const char* msg, int len) {
+    g_output.append(msg, static_cast<size_t>(len));
+}
+
+double logLines(int lines) {
+    g_output.clear();
+    Timestamp begin(Timestamp::now());
+    for (int i = 0; i < lines; ++i) {
+        LOG_INFO << "TcpConnection::handleRead [bench-" << i % 1000 << "] read " << 16384 + i
+                 << " bytes, " << 1.5 * i << " us, fd " << 42 << ' ' << &g_output;
+    }
+    return timeDifference(Timestamp::now(), begin) * 1e9 / lines;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+    g_output.reserve(static_cast<size_t>(lines) * 200);
+    Logger::setOutput(keepOutput);
+
+    double text = logLines(lines);
+    size_t textBytes = g_output.size();
+    string textOutput;
+    textOutput.swap(g_output);
+    g_output.reserve(textOutput.capacity());
+
+    Logger::setBinary(true);
+    double binary = logLines(lines);
+    Logger::setBinary(false);
+    size_t binaryBytes = g_output.size();
+
+    string formatted;
+    formatted.reserve(textBytes);
+    Timestamp begin(Timestamp::now());
+    log_record::format(g_output.data(), g_output.size(), &formatted);
+    double format = timeDifference(Timestamp::now(), begin) * 1e9 / lines;
+
+    printf("text    %6.1f ns/line %6.1f bytes/line\n", text,
+           static_cast<double>(textBytes) / lines);
+    printf("binary  %6.1f ns/line %6.1f bytes/line\n", binary,
+           static_cast<double>(binaryBytes) / lines);
+    printf("format  %6.1f ns/line in the backend\n", format);
+    // the same but for the timestamps, taken a little later
+    printf("%zd of %zd bytes formatted\n", formatted.size(), textBytes);
+}
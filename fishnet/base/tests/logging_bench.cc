@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/timestamp.h"
+
+using namespace fishnet;
+
+// Lines per second of LOG_INFO formatted into a discarding output, timed
+// by the precise clock and by the coarse one, and what reading each costs.
+// Then of a line with kv() fields, as text and as a JSON line.
+//
+// usage: logging_bench [lines]
+
+namespace {
+
+void discard(const char*, int) {}
+
+double linesPerSecond(int lines) {
+    Timestamp begin(Timestamp::now());
+    for (int i = 0; i < lines; ++i) {
+        LOG_INFO << "TcpServer::newConnection [bench] - new connection [bench-" << i
+                 << "] from 127.0.0.1:" << 10000 + i % 50000;
+    }
+    return lines / timeDifference(Timestamp::now(), begin);
+}
+
+double fieldLinesPerSecond(int lines) {
+    const string name = "TcpServer-127.0.0.1:2000#1";
+    Timestamp begin(Timestamp::now());
+    for (int i = 0; i < lines; ++i) {
+        LOG_INFO.kv("conn", name).kv("bytes", 16384 + i).kv("fd", 42) << "read";
+    }
+    return lines / timeDifference(Timestamp::now(), begin);
+}
+
+template <typename Clock>
+double nanosPerCall(Clock clock, int calls) {
+    int64_t sum = 0;
+    Timestamp begin(Timestamp::now());
+    for (int i = 0; i < calls; ++i) {
+        sum += clock().microSecondsSinceEpoch();
+    }
+    double nanos = timeDifference(Timestamp::now(), begin) * 1e9 / calls;
+    // keep the calls
+    if (sum == 42) {
+        printf("\n");
+    }
+    return nanos;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? atoi(argv[1]) : 2000 * 1000;
+    Logger::setOutput(discard);
+
+    printf("precise clock %10.0f lines/s, %5.1f ns a read\n", linesPerSecond(lines),
+           nanosPerCall(&Timestamp::now, lines));
+    Logger::setCoarseClock(true);
+    printf("coarse clock  %10.0f lines/s, %5.1f ns a read\n", linesPerSecond(lines),
+           nanosPerCall(&Timestamp::nowCoarse, lines));
+    Logger::setCoarseClock(false);
+
+    printf("kv text       %10.0f lines/s\n", fieldLinesPerSecond(lines));
+    Logger::setJsonLines(true);
+    printf("kv json lines %10.0f lines/s\n", fieldLinesPerSecond(lines));
+}
@@ -1,6 +1,7 @@
 #include "fishnet/base/thread.h"
 
 #include <linux/unistd.h>
+#include <sched.h>
 #include <sys/prctl.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -111,6 +112,17 @@ void current_thread::sleepUsec(int64_t usec) {
     ::nanosleep(&ts, NULL);
 }
 
+bool current_thread::setCpuAffinity(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        errno = EINVAL;
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
 AtomicInt32 Thread::numCreated_;
 
 Thread::Thread(ThreadFunc func, const string& n)
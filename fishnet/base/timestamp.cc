@@ -3,6 +3,7 @@
 #include <sys/time.h>
 
 #include <cstdio>
+#include <ctime>
 
 #ifndef __STDC_FORMAT_MACROS
 #define __STDC_FORMAT_MACROS
@@ -51,4 +52,11 @@ Timestamp Timestamp::now() {
     return Timestamp(seconds * KMicroSecondsPerSecond + tv.tv_usec);
 }
 
+Timestamp Timestamp::nowCoarse() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    int64_t seconds = ts.tv_sec;
+    return Timestamp(seconds * KMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
 }  // namespace fishnet
\ No newline at end of file
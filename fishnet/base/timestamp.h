@@ -38,6 +38,9 @@ public:
     }
 
     static Timestamp now();
+    /// Of CLOCK_REALTIME_COARSE, as of the last tick, a few milliseconds
+    /// behind at most, but cheaper to read.
+    static Timestamp nowCoarse();
     static Timestamp invalid() {
         return Timestamp();
     }
@@ -6,6 +6,7 @@
 #include <cerrno>
 
 #include "fishnet/base/logging.h"
+#include "fishnet/base/process_info.h"
 #include "fishnet/net/event_loop.h"
 #include "fishnet/net/inet_address.h"
 #include "fishnet/net/sockets_ops.h"
@@ -13,13 +14,20 @@
 using namespace fishnet;
 using namespace fishnet::net;
 
+const int Acceptor::kDefaultMaxAcceptsPerTick;
+const int Acceptor::kReservedFds;
+const double Acceptor::kResumeCheckSeconds = 0.1;
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reuseport)
     : loop_(loop),
       accept_socket_(sockets::createNonblockingOrDie(listen_addr.family())),
       accept_channel_(loop, accept_socket_.fd()),
       listening_(false),
-      idle_fd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
-    assert(idle_fd_ >= 0);
+      paused_(false),
+      fd_paused_(false),
+      max_accepts_per_tick_(kDefaultMaxAcceptsPerTick),
+      max_open_files_(process_info::maxOpenFiles()),
+      num_fd_pauses_(0) {
     accept_socket_.setReuseAddr(true);
     accept_socket_.setReusePort(reuseport);
     accept_socket_.bindAddress(listen_addr);
@@ -27,47 +35,105 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reusepo
 }
 
 Acceptor::~Acceptor() {
+    if (fd_paused_) {
+        loop_->cancel(resume_timer_);
+    }
     accept_channel_.disableAll();
     accept_channel_.remove();
-    ::close(idle_fd_);
 }
 
 void Acceptor::listen() {
     loop_->assertInLoopThread();
     listening_ = true;
     accept_socket_.listen();
-    accept_channel_.enableReading();
+    updateReading();
+}
+
+void Acceptor::pause() {
+    loop_->assertInLoopThread();
+    paused_ = true;
+    updateReading();
+}
+
+void Acceptor::resume() {
+    loop_->assertInLoopThread();
+    paused_ = false;
+    if (fd_paused_) {
+        loop_->cancel(resume_timer_);
+        fd_paused_ = false;
+    }
+    updateReading();
 }
 
 void Acceptor::handleRead() {
     loop_->assertInLoopThread();
-    InetAddress peer_addr;
-    int connfd = accept_socket_.accept(&peer_addr);
-    if (connfd >= 0) {
+    for (int i = 0; i < max_accepts_per_tick_; ++i) {
+        InetAddress peer_addr;
+        int connfd = accept_socket_.accept(&peer_addr);
+        if (connfd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                // leave the connections in the listen queue instead of
+                // accepting and dropping them
+                pauseForFds();
+                break;
+            } else if (errno == EAGAIN) {
+                break;
+            }
+            // the peer gave up or a signal came, go on with the next one
+            continue;
+        }
         if (new_connection_callback_) {
-            // 接受连接后加入后续监听epoll中？
             new_connection_callback_(connfd, peer_addr);
         } else {
-            // 没有回调函数就关闭连接？
             sockets::close(connfd);
         }
-    } else {
-        // 当调用 accept 函数接受客户端连接，函数返回失败，对应的错误码是 EMFILE,
-        // 它表示当前进程打开的文件描述符已达上限，此时，服务器不能再接受客户端连接
-        // 在 poll/epoll 中会存在问题，因为fd不够事件一直无法得到处理：
-        // 水平触发会一直唤醒epoll，边沿触发则会一直忽略后面的连接
-        // 解决办法：
-        // 1、事先准备一个空闲的文件描述符 idlefd，相当于先占一个"坑"位
-        // 2、调用 close 关闭 idlefd，关闭之后，进程就会获得一个文件描述符名额
-        // 3、再次调用 accept 函数, 此时就会返回新的文件描述符 clientfd, 立刻调用 close 函数，
-        //    关闭 clientfd
-        // 4、重新创建空闲文件描述符 idlefd，重新占领 "坑" 位，再出现这种情况的时候又可以使用
-        LOG_SYSERR << "in Acceptor::handleRead";
-        if (errno == EMFILE) {
-            ::close(idle_fd_);
-            idle_fd_ = ::accept(accept_socket_.fd(), nullptr, nullptr);
-            ::close(idle_fd_);
-            idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (nearFdLimit(connfd)) {
+            pauseForFds();
+            break;
         }
     }
-}
\ No newline at end of file
+    // connections left over are picked up on the next tick, level triggered
+}
+
+void Acceptor::updateReading() {
+    bool reading = listening_ && !paused_ && !fd_paused_;
+    if (reading && !accept_channel_.isReading()) {
+        accept_channel_.enableReading();
+    } else if (!reading && accept_channel_.isReading()) {
+        accept_channel_.disableReading();
+    }
+}
+
+bool Acceptor::nearFdLimit(int fd) const {
+    // fds are allocated lowest first, all fds below this one are open
+    return fd >= max_open_files_ - kReservedFds;
+}
+
+void Acceptor::pauseForFds() {
+    if (fd_paused_) {
+        return;
+    }
+    LOG_WARN << "Acceptor::pauseForFds - " << max_open_files_
+             << " max open files nearly used up, stop accepting";
+    fd_paused_ = true;
+    ++num_fd_pauses_;
+    updateReading();
+    resume_timer_ = loop_->runAfter(kResumeCheckSeconds, std::bind(&Acceptor::checkFds, this));
+}
+
+void Acceptor::checkFds() {
+    loop_->assertInLoopThread();
+    // the limit may have been raised meanwhile
+    max_open_files_ = process_info::maxOpenFiles();
+    int lowest_free_fd = ::fcntl(accept_socket_.fd(), F_DUPFD_CLOEXEC, 0);
+    if (lowest_free_fd >= 0) {
+        ::close(lowest_free_fd);
+    }
+    if (lowest_free_fd >= 0 && !nearFdLimit(lowest_free_fd)) {
+        LOG_INFO << "Acceptor::checkFds - fds available again, resume accepting";
+        fd_paused_ = false;
+        updateReading();
+    } else {
+        resume_timer_ = loop_->runAfter(kResumeCheckSeconds, std::bind(&Acceptor::checkFds, this));
+    }
+}
@@ -3,6 +3,7 @@
 #include "fishnet/base/noncopyable.h"
 #include "fishnet/net/channel.h"
 #include "fishnet/net/socket.h"
+#include "fishnet/net/timer_id.h"
 
 namespace fishnet {
 
@@ -11,10 +12,24 @@ namespace net {
 class EventLoop;
 class InetAddress;
 
+///
+/// Accepts TCP connections of a listening socket.
+///
+/// Every readiness event drains the listen queue with accept4(2), up to
+/// max_accepts_per_tick connections so that a connection storm can't starve
+/// the other channels of the loop.
+///
+/// When the process runs out of file descriptors, or comes within
+/// kReservedFds of RLIMIT_NOFILE, accepting pauses and pending connections
+/// stay in the listen queue. It resumes by itself once enough descriptors are
+/// free again, checked every kResumeCheckSeconds.
 class Acceptor : noncopyable {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
 
+    static const int kDefaultMaxAcceptsPerTick = 64;
+    static const int kReservedFds = 16;
+
     Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reuseport);
     ~Acceptor();
 
@@ -22,20 +37,58 @@ public:
         new_connection_callback_ = cb;
     }
 
+    /// Must be called before listen()
+    void setMaxAcceptsPerTick(int n) {
+        max_accepts_per_tick_ = n;
+    }
+
+    /// Socket::setIncomingCpu() of the listening socket.
+    /// Must be called before listen()
+    void setIncomingCpu(int cpu) {
+        accept_socket_.setIncomingCpu(cpu);
+    }
+
     void listen();
 
     bool listening() const {
         return listening_;
     }
 
+    /// Stops accepting, new connections wait in the listen queue.
+    void pause();
+
+    /// Accepts again after pause() or a pause for running out of fds.
+    void resume();
+
+    bool paused() const {
+        return paused_;
+    }
+
+    /// Times accepting paused for running out of fds.
+    int64_t numFdPauses() const {
+        return num_fd_pauses_;
+    }
+
 private:
+    static const double kResumeCheckSeconds;
+
     void handleRead();
+    void updateReading();
+    bool nearFdLimit(int fd) const;
+    void pauseForFds();
+    void checkFds();
+
     EventLoop* loop_;
     Socket accept_socket_;
     Channel accept_channel_;
     NewConnectionCallback new_connection_callback_;
     bool listening_;
-    int idle_fd_;
+    bool paused_;
+    bool fd_paused_;
+    int max_accepts_per_tick_;
+    int max_open_files_;
+    int64_t num_fd_pauses_;
+    TimerId resume_timer_;  // valid while fd_paused_
 };
 
 }  // namespace net
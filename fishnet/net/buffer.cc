@@ -5,6 +5,7 @@
 #include <cerrno>
 
 #include "fishnet/base/types.h"
+#include "fishnet/net/buffer_pool.h"
 #include "fishnet/net/sockets_ops.h"
 
 using namespace fishnet;
@@ -15,26 +16,42 @@ const char Buffer::kCRLF[] = "\r\n";
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
 
+namespace {
+
+// shared by all buffers of the thread, the bytes are appended right away
+__thread char t_extrabuf[65536];
+
+}  // namespace
+
+char* Buffer::allocate(size_t* size) {
+    return BufferPool::instance().allocate(size);
+}
+
+void Buffer::deallocate(char* data, size_t size) {
+    if (data != NULL) {
+        BufferPool::instance().deallocate(data, size);
+    }
+}
+
 ssize_t Buffer::readFd(int fd, int* savedErrno) {
     // saved an ioctl()/FIONREAD call to tell how much to read
-    char extrabuf[65536];
     struct iovec vec[2];
     const size_t writeable = writableBytes();
     vec[0].iov_base = begin() + writerIndex_;
     vec[0].iov_len = writeable;
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
+    vec[1].iov_base = t_extrabuf;
+    vec[1].iov_len = sizeof(t_extrabuf);
     // when there is enough space in this buffer, don't read into extrabuf.
     // when extrabuf is used, we read 128k-1 bytes at most.
-    const int iovcnt = (writeable < sizeof(extrabuf)) ? 2 : 1;
+    const int iovcnt = (writeable < sizeof(t_extrabuf)) ? 2 : 1;
     const ssize_t n = sockets::readv(fd, vec, iovcnt);
     if (n < 0) {
         *savedErrno = errno;
     } else if (implicit_cast<size_t>(n) <= writeable) {
         writerIndex_ += n;
     } else {
-        writerIndex_ = buffer_.size();
-        append(extrabuf, n - writeable);
+        writerIndex_ = capacity_;
+        append(t_extrabuf, n - writeable);
     }
     return n;
 }
\ No newline at end of file
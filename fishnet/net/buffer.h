@@ -4,7 +4,6 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
-#include <vector>
 
 #include "fishnet/base/copyable.h"
 #include "fishnet/base/string_piece.h"
@@ -25,25 +24,49 @@ namespace net {
 /// |                   |                  |                  |
 /// 0      <=      readerIndex   <=   writerIndex    <=     size
 /// @endcode
+///
+/// The storage comes from the BufferPool of the calling thread, it may be
+/// larger than asked for.
 class Buffer : public fishnet::copyable {
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
 
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize),
+        : capacity_(kCheapPrepend + initialSize),
+          buffer_(allocate(&capacity_)),
           readerIndex_(kCheapPrepend),
           writerIndex_(kCheapPrepend) {
         assert(readableBytes() == 0);
-        assert(writableBytes() == initialSize);
+        assert(writableBytes() >= initialSize);
         assert(prependableBytes() == kCheapPrepend);
     }
 
-    // implicit copy-ctor, move-ctor, dtor and assignment ar fine
-    // Note: implicit move-ctor is added in g++ 4.6
+    Buffer(const Buffer& rhs)
+        : capacity_(rhs.capacity_),
+          buffer_(allocate(&capacity_)),
+          readerIndex_(rhs.readerIndex_),
+          writerIndex_(rhs.writerIndex_) {
+        std::copy(rhs.begin(), rhs.begin() + rhs.writerIndex_, begin());
+    }
+
+    // leaves rhs empty and without storage, it allocates again when written
+    Buffer(Buffer&& rhs) noexcept : capacity_(0), buffer_(NULL), readerIndex_(0), writerIndex_(0) {
+        swap(rhs);
+    }
+
+    Buffer& operator=(Buffer rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    ~Buffer() {
+        deallocate(buffer_, capacity_);
+    }
 
     void swap(Buffer& rhs) {
-        buffer_.swap(rhs.buffer_);
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
         std::swap(readerIndex_, rhs.readerIndex_);
         std::swap(writerIndex_, rhs.writerIndex_);
     }
@@ -53,7 +76,7 @@ public:
     }
 
     size_t writableBytes() const {
-        return buffer_.size() - writerIndex_;
+        return capacity_ - writerIndex_;
     }
 
     size_t prependableBytes() const {
@@ -106,8 +129,9 @@ public:
     }
 
     void retrieveAll() {
-        readerIndex_ = kCheapPrepend;
-        writerIndex_ = kCheapPrepend;
+        // without storage, after a move, there's no prependable room either
+        readerIndex_ = buffer_ != NULL ? kCheapPrepend : 0;
+        writerIndex_ = readerIndex_;
     }
 
     void retrieveUntil(const char* end) {
@@ -312,16 +336,16 @@ public:
         std::copy(d, d + len, begin() + readerIndex_);
     }
 
+    /// Moves the readable bytes to storage of about readableBytes() + reserve,
+    /// the old storage goes back to the pool.
     void shrink(size_t reserve) {
-        // FIXME: use vector::shrink_to_fit() in C++ 11 if possible
-        Buffer other;
-        other.ensureWritableBytes(readableBytes() + reserve);
+        Buffer other{std::max(readableBytes() + reserve, kInitialSize)};
         other.append(toStringPiece());
         swap(other);
     }
 
     size_t internalCapacity() const {
-        return buffer_.capacity();
+        return capacity_;
     }
 
     /// Read data directly into buffer.
@@ -331,17 +355,29 @@ public:
     ssize_t readFd(int fd, int* savedErrno);
 
 private:
+    static char* allocate(size_t* size);
+    static void deallocate(char* data, size_t size);
+
     char* begin() {
-        return &*buffer_.begin();
+        return buffer_;
     }
 
     const char* begin() const {
-        return &*buffer_.begin();
+        return buffer_;
     }
 
     void makeSpace(size_t len) {
         if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-            buffer_.resize(writerIndex_ + len);
+            // grow geometrically like std::vector, dropping the dead prefix
+            size_t readable = readableBytes();
+            size_t capacity = std::max(kCheapPrepend + readable + len, 2 * capacity_);
+            char* buffer = allocate(&capacity);
+            std::copy(begin() + readerIndex_, begin() + writerIndex_, buffer + kCheapPrepend);
+            deallocate(buffer_, capacity_);
+            buffer_ = buffer;
+            capacity_ = capacity;
+            readerIndex_ = kCheapPrepend;
+            writerIndex_ = readerIndex_ + readable;
         } else {
             // move readable data to the front, make space inside buffer
             assert(kCheapPrepend < readerIndex_);
@@ -353,7 +389,8 @@ private:
         }
     }
 
-    std::vector<char> buffer_;
+    size_t capacity_;
+    char* buffer_;
     size_t readerIndex_;
     size_t writerIndex_;
 
@@ -0,0 +1,79 @@
+#include "fishnet/net/buffer_pool.h"
+
+#include <cstdlib>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/thread_local_singleton.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const size_t BufferPool::kMinPooledSize;
+const size_t BufferPool::kMaxPooledSize;
+const size_t BufferPool::kMaxCachedBytes;
+
+BufferPool::BufferPool() : cachedBytes_(0), numHits_(0), numMisses_(0) {
+    for (Block*& head : freeLists_) {
+        head = NULL;
+    }
+}
+
+BufferPool::~BufferPool() {
+    for (Block* head : freeLists_) {
+        while (head != NULL) {
+            Block* next = head->next;
+            ::free(head);
+            head = next;
+        }
+    }
+}
+
+BufferPool& BufferPool::instance() {
+    return ThreadLocalSingleton<BufferPool>::instance();
+}
+
+int BufferPool::sizeClass(size_t size) {
+    int index = 0;
+    size_t classSize = kMinPooledSize;
+    while (classSize < size) {
+        classSize <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+char* BufferPool::allocate(size_t* size) {
+    if (*size <= kMaxPooledSize) {
+        int index = sizeClass(*size);
+        *size = kMinPooledSize << index;
+        Block* block = freeLists_[index];
+        if (block != NULL) {
+            freeLists_[index] = block->next;
+            cachedBytes_ -= *size;
+            ++numHits_;
+            return reinterpret_cast<char*>(block);
+        }
+    }
+    ++numMisses_;
+    char* data = static_cast<char*>(::malloc(*size));
+    if (data == NULL) {
+        LOG_SYSFATAL << "BufferPool::allocate " << *size << " bytes";
+    }
+    return data;
+}
+
+void BufferPool::deallocate(char* data, size_t size) {
+    if (size >= kMinPooledSize && size <= kMaxPooledSize &&
+        cachedBytes_ + size <= kMaxCachedBytes) {
+        int index = sizeClass(size);
+        // only whole classes come from allocate()
+        if ((kMinPooledSize << index) == size) {
+            Block* block = reinterpret_cast<Block*>(data);
+            block->next = freeLists_[index];
+            freeLists_[index] = block;
+            cachedBytes_ += size;
+            return;
+        }
+    }
+    ::free(data);
+}
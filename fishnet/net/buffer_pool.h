@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/net/buffer.h"
+
+namespace fishnet {
+
+namespace net {
+
+///
+/// Per thread cache of Buffer storage, i.e. one per EventLoop.
+///
+/// Blocks up to kMaxPooledSize are rounded up to a size class, the initial
+/// storage of a Buffer (kCheapPrepend + kInitialSize) times a power of two,
+/// and kept in a free list of their class when freed, up to kMaxCachedBytes
+/// in total. So a closing connection hands its buffers to the next one the
+/// loop accepts, and the capacity a connection gives back once its buffer is
+/// empty serves the next burst of any connection of the loop, instead of
+/// going back and forth to malloc. Larger blocks are plain malloc.
+///
+/// Blocks are plain malloc memory, one may be freed to the pool of another
+/// thread than the one it came from.
+///
+/// Not thread safe, use instance() of the calling thread.
+class BufferPool : noncopyable {
+public:
+    static const size_t kMinPooledSize = Buffer::kCheapPrepend + Buffer::kInitialSize;
+    static const size_t kMaxPooledSize = kMinPooledSize << 10;  // about 1M
+    static const size_t kMaxCachedBytes = 16 * 1024 * 1024;
+
+    BufferPool();
+    ~BufferPool();
+
+    /// The pool of the calling thread.
+    static BufferPool& instance();
+
+    /// @param size in: bytes wanted, out: bytes allocated, not less
+    char* allocate(size_t* size);
+
+    /// @param size as returned by allocate()
+    void deallocate(char* data, size_t size);
+
+    /// Bytes sitting in the free lists.
+    size_t cachedBytes() const {
+        return cachedBytes_;
+    }
+
+    /// Allocations served from the free lists.
+    int64_t numHits() const {
+        return numHits_;
+    }
+
+    /// Allocations that went to malloc.
+    int64_t numMisses() const {
+        return numMisses_;
+    }
+
+private:
+    static const int kNumClasses = 11;
+
+    static int sizeClass(size_t size);
+
+    struct Block {
+        Block* next;
+    };
+
+    Block* freeLists_[kNumClasses];
+    size_t cachedBytes_;
+    int64_t numHits_;
+    int64_t numMisses_;
+};
+
+}  // namespace net
+}  // namespace fishnet
@@ -42,6 +42,8 @@ class Buffer;
 class TcpConnection;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+// refcounted message, can be queued for sending without copying
+using SharedPayload = std::shared_ptr<const string>;
 using TimerCallback = std::function<void()>;
 using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
@@ -41,7 +41,9 @@ Channel::Channel(EventLoop* loop, int fd)
       logHup_(true),
       tied_(false),
       eventHandling_(false),
-      addedToLoop_(false) {}
+      addedToLoop_(false),
+      edgeTriggered_(false),
+      registered_(false) {}
 
 Channel::~Channel() {
     assert(!eventHandling_);
@@ -58,12 +60,14 @@ void Channel::tie(const std::shared_ptr<void>& obj) {
 
 void Channel::update() {
     addedToLoop_ = true;
+    registered_ = !isNoneEvent();
     loop_->updateChannel(this);
 }
 
 void Channel::remove() {
     assert(isNoneEvent());
     addedToLoop_ = false;
+    registered_ = false;
     loop_->removeChannel(this);
 }
 
@@ -102,13 +106,15 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
         }
     }
 
-    if (revents_ & (POLLIN | POLLPRI | POLLRDHUP)) {
+    // an edge-triggered fd reports all it's ready for, not only what's
+    // enabled
+    if ((revents_ & (POLLIN | POLLPRI | POLLRDHUP)) && (!edgeTriggered_ || isReading())) {
         if (readCallback_) {
             readCallback_(receiveTime);
         }
     }
 
-    if (revents_ & POLLOUT) {
+    if ((revents_ & POLLOUT) && (!edgeTriggered_ || isWriting())) {
         if (writeCallback_) {
             writeCallback_();
         }
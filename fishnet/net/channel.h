@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cassert>
 #include <functional>
 #include <memory>
 
@@ -60,22 +61,22 @@ public:
 
     void enableReading() {
         events_ |= kReadEvent;
-        update();
+        updateInterest();
     }
 
     void disableReading() {
         events_ &= ~kReadEvent;
-        update();
+        updateInterest();
     }
 
     void enableWriting() {
         events_ |= kWriteEvent;
-        update();
+        updateInterest();
     }
 
     void disableWriting() {
         events_ &= ~kWriteEvent;
-        update();
+        updateInterest();
     }
 
     void disableAll() {
@@ -91,6 +92,29 @@ public:
         return events_ & kReadEvent;
     }
 
+    ///
+    /// Edge-triggered mode, for pollers supporting it, see
+    /// EventLoop::supportsEdgeTriggered().
+    ///
+    /// The fd stays registered for reading and writing as long as any event
+    /// is enabled, enabling and disabling events only decides which
+    /// callbacks run, without a Poller update. The owner must read and write
+    /// until EAGAIN, readiness is reported only when it changes.
+    /// Set before enabling any event.
+    void setEdgeTriggered(bool on) {
+        assert(isNoneEvent());
+        edgeTriggered_ = on;
+    }
+
+    bool edgeTriggered() const {
+        return edgeTriggered_;
+    }
+
+    /// The events to register with the poller.
+    int registeredEvents() const {
+        return edgeTriggered_ && !isNoneEvent() ? kReadEvent | kWriteEvent : events_;
+    }
+
     // for Poller
     int index() {
         return index_;
@@ -118,6 +142,12 @@ private:
     static string eventsToString(int fd, int ev);
 
     void update();
+    void updateInterest() {
+        // a registered edge-triggered fd already waits for everything
+        if (!(edgeTriggered_ && registered_ && !isNoneEvent())) {
+            update();
+        }
+    }
 
     void handleEventWithGuard(Timestamp receiveTime);
 
@@ -136,6 +166,8 @@ private:
     bool tied_;
     bool eventHandling_;
     bool addedToLoop_;
+    bool edgeTriggered_;
+    bool registered_;  // with events in the poller
     ReadEventCallback readCallback_;
     EventCallback writeCallback_;
     EventCallback closeCallback_;
@@ -0,0 +1,105 @@
+#include "fishnet/net/connection_table.h"
+
+#include <cassert>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/net/tcp_connection.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const int ConnectionTable::kMaxShards;
+const uint32_t ConnectionTable::kMaxSlots;
+const uint32_t ConnectionTable::kNoSlot;
+
+ConnectionTable::ConnectionTable(int shard)
+    : shard_(static_cast<uint64_t>(shard)), freeHead_(kNoSlot), size_(0) {
+    assert(0 <= shard && shard < kMaxShards);
+}
+
+uint64_t ConnectionTable::acquire() {
+    MutexLockGuard lock{mutex_};
+    uint32_t index = freeHead_;
+    if (index != kNoSlot) {
+        freeHead_ = slots_[index].nextFree;
+    } else {
+        if (slots_.size() >= kMaxSlots) {
+            LOG_FATAL << "ConnectionTable::acquire - more than " << kMaxSlots
+                      << " connections in shard " << shard_;
+        }
+        index = static_cast<uint32_t>(slots_.size());
+        slots_.push_back(Slot{0, kNoSlot, false, TcpConnectionPtr()});
+    }
+    Slot& slot = slots_[index];
+    // generation 0 is never used, so that 0 is never an id
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    slot.used = true;
+    ++size_;
+    return (static_cast<uint64_t>(slot.generation) << 32) | (shard_ << 24) | index;
+}
+
+uint32_t ConnectionTable::indexOf(uint64_t id) const {
+    mutex_.assertLocked();
+    uint32_t index = static_cast<uint32_t>(id & (kMaxSlots - 1));
+    if (index >= slots_.size() || static_cast<uint64_t>(shardOf(id)) != shard_) {
+        return kNoSlot;
+    }
+    const Slot& slot = slots_[index];
+    if (!slot.used || slot.generation != static_cast<uint32_t>(id >> 32)) {
+        return kNoSlot;
+    }
+    return index;
+}
+
+void ConnectionTable::set(uint64_t id, const TcpConnectionPtr& conn) {
+    MutexLockGuard lock{mutex_};
+    uint32_t index = indexOf(id);
+    assert(index != kNoSlot);
+    slots_[index].conn = conn;
+}
+
+bool ConnectionTable::release(uint64_t id) {
+    TcpConnectionPtr conn;  // destroyed out of the lock
+    MutexLockGuard lock{mutex_};
+    uint32_t index = indexOf(id);
+    if (index == kNoSlot) {
+        return false;
+    }
+    Slot& slot = slots_[index];
+    conn.swap(slot.conn);
+    slot.used = false;
+    slot.nextFree = freeHead_;
+    freeHead_ = index;
+    --size_;
+    return true;
+}
+
+TcpConnectionPtr ConnectionTable::find(uint64_t id) const {
+    MutexLockGuard lock{mutex_};
+    uint32_t index = indexOf(id);
+    return index != kNoSlot ? slots_[index].conn : TcpConnectionPtr();
+}
+
+size_t ConnectionTable::size() const {
+    MutexLockGuard lock{mutex_};
+    return size_;
+}
+
+void ConnectionTable::takeAll(std::vector<TcpConnectionPtr>* conns) {
+    MutexLockGuard lock{mutex_};
+    for (uint32_t index = 0; index < slots_.size(); ++index) {
+        Slot& slot = slots_[index];
+        if (slot.used) {
+            if (slot.conn) {
+                conns->push_back(slot.conn);
+                slot.conn.reset();
+            }
+            slot.used = false;
+            slot.nextFree = freeHead_;
+            freeHead_ = index;
+        }
+    }
+    size_ = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "fishnet/base/mutex.h"
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/net/callbacks.h"
+
+namespace fishnet {
+
+namespace net {
+
+///
+/// Dense slot table of the connections of one EventLoop, one shard of the
+/// connections of a TcpServer.
+///
+/// A connection id packs the slot generation (high 32 bits), the shard
+/// (8 bits) and the slot index (low 24 bits). A freed slot is reused by the
+/// next connection with its generation bumped, so a stale id never finds
+/// the new owner. Ids are never 0.
+///
+/// Insert and erase are O(1) and in loop thread, find() is O(1) and thread
+/// safe, guarded by a mutex held only for the slot access.
+class ConnectionTable : noncopyable {
+public:
+    static const int kMaxShards = 1 << 8;
+    static const uint32_t kMaxSlots = 1 << 24;
+
+    explicit ConnectionTable(int shard);
+
+    /// The shard of an id, to route it to its table.
+    static int shardOf(uint64_t id) {
+        return static_cast<int>((id >> 24) & (kMaxShards - 1));
+    }
+
+    /// Takes a free slot, returns its id, the slot is empty until set().
+    uint64_t acquire();
+
+    void set(uint64_t id, const TcpConnectionPtr& conn);
+
+    /// Frees the slot of id, returns false if it's not in the table.
+    bool release(uint64_t id);
+
+    /// NULL if id is not in the table.
+    /// Thread safe.
+    TcpConnectionPtr find(uint64_t id) const;
+
+    /// Connections in the table.
+    /// Thread safe.
+    size_t size() const;
+
+    /// Empties the table into conns.
+    void takeAll(std::vector<TcpConnectionPtr>* conns);
+
+private:
+    struct Slot {
+        uint32_t generation;
+        uint32_t nextFree;
+        bool used;
+        TcpConnectionPtr conn;
+    };
+
+    static const uint32_t kNoSlot = UINT32_MAX;
+
+    /// kNoSlot if id is stale.
+    uint32_t indexOf(uint64_t id) const;
+
+    const uint64_t shard_;
+    mutable MutexLock mutex_;
+    std::vector<Slot> slots_ GUARDED_BY(mutex_);
+    uint32_t freeHead_ GUARDED_BY(mutex_);
+    size_t size_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace fishnet
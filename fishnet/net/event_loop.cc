@@ -7,7 +7,6 @@
 #include <algorithm>
 
 #include "fishnet/base/logging.h"
-#include "fishnet/base/mutex.h"
 #include "fishnet/base/timestamp.h"
 #include "fishnet/net/callbacks.h"
 #include "fishnet/net/channel.h"
@@ -58,7 +57,12 @@ EventLoop::EventLoop()
       timerQueue_(new TimerQueue{this}),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel{this, wakeupFd_}),
-      currentActiveChannel_(NULL) {
+      currentActiveChannel_(NULL),
+      wakeupPending_(false),
+      numConnections_(0),
+      slowCallbackMicros_(100 * 1000),
+      busyPollMicros_(0),
+      spinning_(false) {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
     if (t_loopInThisThread) {
         LOG_FATAL << "Another EventLoop " << t_loopInThisThread << " exists in this thread "
@@ -90,17 +94,37 @@ void EventLoop::loop() {
 
     while (!quit_) {
         activeChannels_.clear();
+        const int64_t busyPollMicros = busyPollMicros_.load(std::memory_order_relaxed);
         // 每10ms超时唤醒
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        pollReturnTime_ = poller_->poll(pollTimeout(busyPollMicros), &activeChannels_);
         ++iteration_;
+        int64_t numActive = static_cast<int64_t>(activeChannels_.size());
+        if (busyPollMicros > 0 && (numActive > 0 || pendingFunctors_.size() > 0)) {
+            lastBusyTime_ = pollReturnTime_;
+            spinning_.store(true, std::memory_order_relaxed);
+        }
+        EventLoopMetrics::add(&metrics_.pollWakeups, 1);
+        EventLoopMetrics::add(&metrics_.activeChannels, numActive);
+        EventLoopMetrics::max(&metrics_.maxActiveChannels, numActive);
         if (Logger::LogLevel() <= Logger::LogLevel::TRACE) {
             printActiveChannels();
         }
         eventHanding_ = true;
+        const int64_t slowMicros = slowCallbackMicros_.load(std::memory_order_relaxed);
+        Timestamp callbackStart = pollReturnTime_;
         for (Channel* channel : activeChannels_) {
             currentActiveChannel_ = channel;
             // 处理事件
             currentActiveChannel_->handleEvent(pollReturnTime_);
+            callbackStart = checkSlowCallback(callbackStart, slowMicros, channel->fd());
+        }
+        if (numActive > 0) {
+            if (slowMicros <= 0) {
+                callbackStart = Timestamp::now();
+            }
+            EventLoopMetrics::add(&metrics_.handleEventMicros,
+                                  callbackStart.microSecondsSinceEpoch() -
+                                      pollReturnTime_.microSecondsSinceEpoch());
         }
         currentActiveChannel_ = NULL;
         eventHanding_ = false;
@@ -127,18 +151,24 @@ void EventLoop::runInLoop(Functor cb) {
 }
 
 void EventLoop::queueInLoop(Functor cb) {
-    {
-        MutexLockGuard lock(mutex_);
-        pendingFunctors_.push_back(std::move(cb));
-    }
+    pendingFunctors_.push(std::move(cb));
 
     if (!isInLoopThread() || callingPendingFunctors_) {
-        wakeup();
+        // a stale false only costs a needless wakeup, a true is confirmed
+        // after the fence pairing with pollTimeout(): either the loop sees
+        // this functor before blocking or this sees that it stopped spinning
+        bool spinning = spinning_.load(std::memory_order_relaxed);
+        if (spinning) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            spinning = spinning_.load(std::memory_order_relaxed);
+        }
+        if (!spinning && !wakeupPending_.exchange(true)) {
+            wakeup();
+        }
     }
 }
 
 size_t EventLoop::queueSize() const {
-    MutexLockGuard lock(mutex_);
     return pendingFunctors_.size();
 }
 
@@ -160,12 +190,21 @@ void EventLoop::cancel(TimerId timerId) {
     return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::restart(TimerId timerId, double delay) {
+    timerQueue_->restart(timerId, addTime(Timestamp::now(), delay));
+}
+
 void EventLoop::updateChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
+    EventLoopMetrics::add(&metrics_.channelUpdates, 1);
     poller_->updateChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const {
+    return poller_->supportsEdgeTriggered();
+}
+
 void EventLoop::removeChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
@@ -205,21 +244,83 @@ void EventLoop::handleRead() {
     }
 }
 
+int EventLoop::pollTimeout(int64_t busyPollMicros) {
+    if (!spinning_.load(std::memory_order_relaxed)) {
+        return kPollTimeMs;
+    }
+    if (busyPollMicros > 0 && Timestamp::now().microSecondsSinceEpoch() -
+                                      lastBusyTime_.microSecondsSinceEpoch() <
+                                  busyPollMicros) {
+        EventLoopMetrics::add(&metrics_.busyPolls, 1);
+        return 0;
+    }
+    // out of budget, producers write the eventfd again from now on, those
+    // which still saw spinning_ left their functors for this check
+    spinning_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return pendingFunctors_.size() > 0 ? 0 : kPollTimeMs;
+}
+
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
-    // 节省锁的使用
-    {
-        MutexLockGuard lock(mutex_);
-        functors.swap(pendingFunctors_);
+    // re-enable wakeups before draining, so a functor pushed after the drain
+    // always writes wakeupFd_ and the next poll doesn't sleep on it
+    wakeupPending_.exchange(false);
+
+    // run only what is queued now, functors queued by functors run in the
+    // next iteration
+    size_t n = pendingFunctors_.size();
+    if (n > 0) {
+        const int64_t slowMicros = slowCallbackMicros_.load(std::memory_order_relaxed);
+        const Timestamp start{Timestamp::now()};
+        Timestamp functorStart = start;
+        int64_t numRun = 0;
+        Functor functor;
+        while (n-- > 0 && pendingFunctors_.pop(&functor)) {
+            functor();
+            ++numRun;
+            functorStart = checkSlowCallback(functorStart, slowMicros, -1);
+        }
+        if (slowMicros <= 0) {
+            functorStart = Timestamp::now();
+        }
+        EventLoopMetrics::add(&metrics_.functorsRun, numRun);
+        EventLoopMetrics::max(&metrics_.queueHighWater, numRun);
+        EventLoopMetrics::add(
+            &metrics_.pendingFunctorsMicros,
+            functorStart.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
     }
-
-    for (const Functor& functor : functors) {
-        functor();
+    // output coalesced by the events and the functors above, functors
+    // queued by the flushes run in the next iteration
+    if (!flushFunctors_.empty()) {
+        runningFlushFunctors_.swap(flushFunctors_);
+        for (const Functor& flush : runningFlushFunctors_) {
+            flush();
+        }
+        runningFlushFunctors_.clear();
     }
     callingPendingFunctors_ = false;
 }
 
+Timestamp EventLoop::checkSlowCallback(Timestamp start, int64_t thresholdMicros, int fd) {
+    if (thresholdMicros <= 0) {
+        // disabled, the caller reads the clock once for the whole batch
+        return start;
+    }
+    Timestamp end{Timestamp::now()};
+    int64_t micros = end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+    if (micros >= thresholdMicros) {
+        EventLoopMetrics::add(&metrics_.slowCallbacks, 1);
+        if (fd >= 0) {
+            LOG_WARN << "EventLoop::loop() slow callback of fd " << fd << " took " << micros
+                     << " us";
+        } else {
+            LOG_WARN << "EventLoop::loop() slow pending functor took " << micros << " us";
+        }
+    }
+    return end;
+}
+
 void EventLoop::printActiveChannels() const {
     for (const Channel* channel : activeChannels_) {
         LOG_TRACE << "{" << channel->reventsToString() << "} ";
@@ -7,11 +7,12 @@
 #include <vector>
 
 #include "fishnet/base/current_thread.h"
-#include "fishnet/base/mutex.h"
+#include "fishnet/base/mpsc_queue.h"
 #include "fishnet/base/noncopyable.h"
 #include "fishnet/base/timestamp.h"
 #include "fishnet/net/callbacks.h"
 #include "fishnet/net/channel.h"
+#include "fishnet/net/event_loop_metrics.h"
 #include "fishnet/net/timer_id.h"
 
 namespace fishnet {
@@ -57,6 +58,32 @@ public:
         return iteration_;
     }
 
+    /// Health counters, safe to read from other threads.
+    const EventLoopMetrics& metrics() const {
+        return metrics_;
+    }
+
+    /// Channel callbacks and functors running longer than this are logged
+    /// with their fd and counted in metrics().slowCallbacks.
+    /// Default 100ms, 0 disables it along with the clock read after each
+    /// callback.
+    /// Safe to call from other threads.
+    void setSlowCallbackThreshold(double seconds) {
+        slowCallbackMicros_.store(
+            static_cast<int64_t>(seconds * Timestamp::KMicroSecondsPerSecond),
+            std::memory_order_relaxed);
+    }
+
+    /// Low latency mode: after an iteration with work, the loop keeps
+    /// polling with zero timeout for this long before it blocks again, and
+    /// while spinning queueInLoop() skips the eventfd write. Burns a CPU,
+    /// best with the loop pinned, see EventLoopThread::setCpuAffinity().
+    /// Default 0, always blocks.
+    /// Safe to call from other threads.
+    void setBusyPollMicros(int64_t micros) {
+        busyPollMicros_.store(micros, std::memory_order_relaxed);
+    }
+
     /// Runs callback immediately in the loop thread.
     /// It wakes up the loop, and run the cb.
     /// If in the same loop thread, cb is run within the function.
@@ -65,11 +92,27 @@ public:
 
     /// Queues callback in the loop thread.
     /// Runs after finish pooling.
-    /// Safe to call from other threads.
+    /// Safe to call from other threads, lock free.
     void queueInLoop(Functor cb);
 
     size_t queueSize() const;
 
+    /// Queues callback to run at the end of the current iteration, after
+    /// the active channels and the pending functors, before polling again.
+    /// Used to flush output coalesced over an iteration.
+    /// In loop thread only.
+    void queueFlush(Functor cb) {
+        assertInLoopThread();
+        flushFunctors_.push_back(std::move(cb));
+    }
+
+    /// TcpConnections created for this loop and not yet destroyed,
+    /// the load counter of loop selection.
+    /// Safe to call from other threads.
+    int numConnections() const {
+        return numConnections_.load(std::memory_order_relaxed);
+    }
+
     // times
 
     ///
@@ -96,8 +139,28 @@ public:
     ///
     void cancel(TimerId timerId);
 
+    ///
+    /// Reschedules the timer to run after @c delay seconds,
+    /// cheaper than cancel() plus runAfter().
+    /// No-op if the timer has expired or been canceled.
+    /// Safe to call from other threads.
+    ///
+    void restart(TimerId timerId, double delay);
+
+    /// Whether the poller honors Channel::setEdgeTriggered().
+    bool supportsEdgeTriggered() const;
+
     // internal usage
     void wakeup();
+    void addConnections(int delta) {
+        numConnections_.fetch_add(delta, std::memory_order_relaxed);
+    }
+    void recordTimerLateness(int64_t micros) {
+        micros = micros > 0 ? micros : 0;
+        EventLoopMetrics::add(&metrics_.timerWakeups, 1);
+        EventLoopMetrics::add(&metrics_.timerLatenessMicros, micros);
+        EventLoopMetrics::max(&metrics_.maxTimerLatenessMicros, micros);
+    }
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
     bool hasChannel(Channel* channel);
@@ -135,6 +198,10 @@ private:
     void abortNotInLoopThread();
     void handleRead();  // waked up
     void doPendingFunctors();
+    // poll timeout of the next iteration, 0 while spinning
+    int pollTimeout(int64_t busyPollMicros);
+    // @return when the callback ended, @c start if the check is disabled
+    Timestamp checkSlowCallback(Timestamp start, int64_t thresholdMicros, int fd);
 
     void printActiveChannels() const;  // DEBUG
 
@@ -160,8 +227,21 @@ private:
     ChannelList activeChannels_;
     Channel* currentActiveChannel_;
 
-    mutable MutexLock mutex_;
-    std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+    MpscQueue<Functor> pendingFunctors_;
+    // loop thread only
+    std::vector<Functor> flushFunctors_;
+    std::vector<Functor> runningFlushFunctors_;
+    // set by the first producer after the loop drained pendingFunctors_,
+    // later producers skip the eventfd write
+    std::atomic<bool> wakeupPending_;
+    std::atomic<int> numConnections_;
+
+    EventLoopMetrics metrics_;
+    std::atomic<int64_t> slowCallbackMicros_;
+    std::atomic<int64_t> busyPollMicros_;
+    // producers skip the eventfd while set, see pollTimeout()
+    std::atomic<bool> spinning_;
+    Timestamp lastBusyTime_;  // loop thread only
 };
 
 }  // namespace net
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "fishnet/base/noncopyable.h"
+
+namespace fishnet {
+
+namespace net {
+
+///
+/// Health counters of one EventLoop.
+///
+/// Only the loop thread writes them, with plain relaxed loads and stores
+/// instead of read-modify-write, so they cost the loop almost nothing. Any
+/// thread may read them lock free, e.g. to export them, each counter is
+/// consistent on its own but a snapshot is not atomic as a whole.
+///
+/// Times are in microseconds.
+struct EventLoopMetrics : noncopyable {
+    /// A copy of the counters, for export.
+    struct Snapshot {
+        int64_t pollWakeups;
+        int64_t activeChannels;        // summed over all wakeups
+        int64_t maxActiveChannels;     // of a single wakeup
+        int64_t handleEventMicros;     // in Channel::handleEvent
+        int64_t pendingFunctorsMicros; // in doPendingFunctors
+        int64_t functorsRun;
+        int64_t queueHighWater;        // most functors drained at once
+        int64_t timerWakeups;
+        int64_t timerLatenessMicros;   // summed over all timer wakeups
+        int64_t maxTimerLatenessMicros;
+        int64_t slowCallbacks;
+        int64_t channelUpdates;        // Poller updates, e.g. epoll_ctl
+        int64_t busyPolls;             // zero timeout polls while spinning
+    };
+
+    EventLoopMetrics()
+        : pollWakeups(0),
+          activeChannels(0),
+          maxActiveChannels(0),
+          handleEventMicros(0),
+          pendingFunctorsMicros(0),
+          functorsRun(0),
+          queueHighWater(0),
+          timerWakeups(0),
+          timerLatenessMicros(0),
+          maxTimerLatenessMicros(0),
+          slowCallbacks(0),
+          channelUpdates(0),
+          busyPolls(0) {}
+
+    Snapshot snapshot() const {
+        Snapshot s;
+        s.pollWakeups = pollWakeups.load(std::memory_order_relaxed);
+        s.activeChannels = activeChannels.load(std::memory_order_relaxed);
+        s.maxActiveChannels = maxActiveChannels.load(std::memory_order_relaxed);
+        s.handleEventMicros = handleEventMicros.load(std::memory_order_relaxed);
+        s.pendingFunctorsMicros = pendingFunctorsMicros.load(std::memory_order_relaxed);
+        s.functorsRun = functorsRun.load(std::memory_order_relaxed);
+        s.queueHighWater = queueHighWater.load(std::memory_order_relaxed);
+        s.timerWakeups = timerWakeups.load(std::memory_order_relaxed);
+        s.timerLatenessMicros = timerLatenessMicros.load(std::memory_order_relaxed);
+        s.maxTimerLatenessMicros = maxTimerLatenessMicros.load(std::memory_order_relaxed);
+        s.slowCallbacks = slowCallbacks.load(std::memory_order_relaxed);
+        s.channelUpdates = channelUpdates.load(std::memory_order_relaxed);
+        s.busyPolls = busyPolls.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // writers, loop thread only
+
+    static void add(std::atomic<int64_t>* counter, int64_t n) {
+        counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void max(std::atomic<int64_t>* counter, int64_t n) {
+        if (n > counter->load(std::memory_order_relaxed)) {
+            counter->store(n, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<int64_t> pollWakeups;
+    std::atomic<int64_t> activeChannels;
+    std::atomic<int64_t> maxActiveChannels;
+    std::atomic<int64_t> handleEventMicros;
+    std::atomic<int64_t> pendingFunctorsMicros;
+    std::atomic<int64_t> functorsRun;
+    std::atomic<int64_t> queueHighWater;
+    std::atomic<int64_t> timerWakeups;
+    std::atomic<int64_t> timerLatenessMicros;
+    std::atomic<int64_t> maxTimerLatenessMicros;
+    std::atomic<int64_t> slowCallbacks;
+    std::atomic<int64_t> channelUpdates;
+    std::atomic<int64_t> busyPolls;
+};
+
+}  // namespace net
+}  // namespace fishnet
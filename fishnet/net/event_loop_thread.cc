@@ -1,5 +1,6 @@
 #include "fishnet/net/event_loop_thread.h"
 
+#include "fishnet/base/logging.h"
 #include "fishnet/base/mutex.h"
 #include "fishnet/net/event_loop.h"
 
@@ -13,7 +14,9 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
       thread_(std::bind(&EventLoopThread::threadFunc, this), name),
       mutex_(),
       cond_(mutex_),
-      callback_(cb) {}
+      callback_(cb),
+      cpu_(-1),
+      busyPollMicros_(0) {}
 
 EventLoopThread::~EventLoopThread() {
     exiting_ = true;
@@ -40,7 +43,12 @@ EventLoop* EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+    // before the loop allocates anything, so its memory is local to the CPU
+    if (cpu_ >= 0 && !current_thread::setCpuAffinity(cpu_)) {
+        LOG_SYSERR << "EventLoopThread::threadFunc - can't pin to CPU " << cpu_;
+    }
     EventLoop loop;
+    loop.setBusyPollMicros(busyPollMicros_);
 
     if (callback_) {
         callback_(&loop);
@@ -21,6 +21,18 @@ public:
 
     ~EventLoopThread();
 
+    /// Pins the loop thread to @c cpu, -1 (default) leaves it to the
+    /// scheduler. Must be called before startLoop().
+    void setCpuAffinity(int cpu) {
+        cpu_ = cpu;
+    }
+
+    /// EventLoop::setBusyPollMicros() of the loop.
+    /// Must be called before startLoop().
+    void setBusyPollMicros(int64_t micros) {
+        busyPollMicros_ = micros;
+    }
+
     EventLoop* startLoop();
 
 private:
@@ -32,6 +44,8 @@ private:
     MutexLock mutex_;
     Condition cond_ GUARDED_BY(mutex_);
     ThreadInitCallback callback_;
+    int cpu_;
+    int64_t busyPollMicros_;
 };
 }  // namespace net
 }  // namespace fishnet
\ No newline at end of file
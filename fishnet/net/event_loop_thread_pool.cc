@@ -26,6 +26,9 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
         EventLoopThread* t = new EventLoopThread{cb, buf};
+        if (!cpus_.empty()) {
+            t->setCpuAffinity(cpus_[static_cast<size_t>(i) % cpus_.size()]);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());
     }
@@ -49,12 +52,80 @@ EventLoop* EventLoopThreadPool::getNextLoop() {
     return loop;
 }
 
+template <typename Load>
+EventLoop* EventLoopThreadPool::getLeastLoadedLoop(Load load) {
+    baseLoop_->assertInLoopThread();
+    assert(started_);
+    if (loops_.empty()) {
+        return baseLoop_;
+    }
+    // start where round-robin is, so ties don't all go to the first loop
+    size_t n = loops_.size();
+    size_t best = static_cast<size_t>(next_);
+    auto bestLoad = load(loops_[best]);
+    for (size_t i = 1; i < n && bestLoad > 0; ++i) {
+        size_t index = (static_cast<size_t>(next_) + i) % n;
+        auto l = load(loops_[index]);
+        if (l < bestLoad) {
+            best = index;
+            bestLoad = l;
+        }
+    }
+    next_ = static_cast<int>((best + 1) % n);
+    return loops_[best];
+}
+
+EventLoop* EventLoopThreadPool::getLoopForCpu(int cpu) const {
+    assert(started_);
+    if (cpu < 0 || cpus_.empty()) {
+        return NULL;
+    }
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        if (cpus_[i % cpus_.size()] == cpu) {
+            return loops_[i];
+        }
+    }
+    return NULL;
+}
+
+int EventLoopThreadPool::getCpuOfLoop(EventLoop* loop) const {
+    assert(started_);
+    if (cpus_.empty()) {
+        return -1;
+    }
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        if (loops_[i] == loop) {
+            return cpus_[i % cpus_.size()];
+        }
+    }
+    return -1;
+}
+
+EventLoop* EventLoopThreadPool::getLeastConnectionsLoop() {
+    return getLeastLoadedLoop([](EventLoop* loop) { return loop->numConnections(); });
+}
+
+EventLoop* EventLoopThreadPool::getLeastQueuedLoop() {
+    return getLeastLoadedLoop([](EventLoop* loop) { return loop->queueSize(); });
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode) {
     baseLoop_->assertInLoopThread();
     EventLoop* loop = baseLoop_;
 
     if (!loops_.empty()) {
-        loop = loops_[hashCode % loops_.size()];
+        // Lamping and Veach, "A Fast, Minimal Memory, Consistent Hash Algorithm"
+        uint64_t key = hashCode;
+        int64_t bucket = -1;
+        int64_t next = 0;
+        while (next < static_cast<int64_t>(loops_.size())) {
+            bucket = next;
+            key = key * 2862933555777941757ULL + 1;
+            next = static_cast<int64_t>(static_cast<double>(bucket + 1) *
+                                        (static_cast<double>(int64_t{1} << 31) /
+                                         static_cast<double>((key >> 33) + 1)));
+        }
+        loop = loops_[static_cast<size_t>(bucket)];
     }
 
     return loop;
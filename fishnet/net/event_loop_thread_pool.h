@@ -27,6 +27,17 @@ public:
         numThreads_ = numThreads;
     }
 
+    /// Pins the i-th loop thread to cpus[i % cpus.size()], empty (default)
+    /// leaves them to the scheduler. A loop thread is pinned before it
+    /// builds its EventLoop, so the loop, its buffer pools and the
+    /// connections it creates are first touched on, and with the default
+    /// memory policy allocated from, the NUMA node of its CPU.
+    /// The base loop is left alone.
+    /// Must be called before start()
+    void setCpuAffinity(const std::vector<int>& cpus) {
+        cpus_ = cpus;
+    }
+
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
     /// valid after calling start()
@@ -34,9 +45,32 @@ public:
     /// round-robin
     EventLoop* getNextLoop();
 
+    /// valid after calling start()
+    ///
+    /// the loop with the fewest connections, see EventLoop::numConnections()
+    EventLoop* getLeastConnectionsLoop();
+
+    /// valid after calling start()
+    ///
+    /// the loop with the fewest pending functors, see EventLoop::queueSize()
+    EventLoop* getLeastQueuedLoop();
+
     /// with the same hash code, it will always return the same EventLoop
+    ///
+    /// jump consistent hash, only 1/N of the hash codes move when the N-th
+    /// thread is added
     EventLoop* getLoopForHash(size_t hashCode);
 
+    /// valid after calling start()
+    ///
+    /// the first loop pinned to @c cpu, NULL if none is
+    EventLoop* getLoopForCpu(int cpu) const;
+
+    /// valid after calling start()
+    ///
+    /// the CPU @c loop is pinned to, -1 if it isn't
+    int getCpuOfLoop(EventLoop* loop) const;
+
     std::vector<EventLoop*> getAllLoops();
 
     bool started() const {
@@ -48,6 +82,9 @@ public:
     }
 
 private:
+    template <typename Load>
+    EventLoop* getLeastLoadedLoop(Load load);
+
     EventLoop* baseLoop_;
     string name_;
     bool started_;
@@ -55,6 +92,7 @@ private:
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
+    std::vector<int> cpus_;
 };
 
 }  // namespace net
@@ -0,0 +1,73 @@
+#include "fishnet/net/idle_reaper.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/weak_callback.h"
+#include "fishnet/net/connection_table.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/tcp_connection.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const int IdleReaper::kNumBuckets;
+
+IdleReaper::IdleReaper(EventLoop* loop, const ConnectionTable* connections,
+                       double timeoutSeconds)
+    : loop_(loop),
+      connections_(connections),
+      timeout_(timeoutSeconds),
+      tick_(timeoutSeconds / kNumBuckets),
+      buckets_(kNumBuckets + 1),
+      current_(0),
+      numReaped_(0) {
+    assert(timeoutSeconds > 0.0);
+}
+
+IdleReaper::~IdleReaper() = default;
+
+void IdleReaper::start() {
+    timerId_ = loop_->runEvery(tick_, makeWeakCallback(shared_from_this(), &IdleReaper::onTick));
+}
+
+void IdleReaper::stop() {
+    loop_->cancel(timerId_);
+}
+
+void IdleReaper::add(const TcpConnectionPtr& conn) {
+    loop_->assertInLoopThread();
+    assert(conn->getLoop() == loop_);
+    if (conn->connected()) {
+        buckets_[(current_ + kNumBuckets - 1) % buckets_.size()].push_back(conn->id());
+    }
+}
+
+void IdleReaper::onTick() {
+    loop_->assertInLoopThread();
+    // the bucket may get refilled below, process a copy
+    scratch_.swap(buckets_[current_]);
+    current_ = (current_ + 1) % buckets_.size();
+
+    Timestamp now{Timestamp::now()};
+    for (uint64_t id : scratch_) {
+        TcpConnectionPtr conn{connections_->find(id)};
+        if (!conn || !conn->connected()) {
+            continue;
+        }
+        double idle = timeDifference(now, conn->lastActiveTime());
+        if (idle >= timeout_) {
+            LOG_INFO << "IdleReaper - connection #" << id << " idle for " << idle
+                     << "s, closing";
+            conn->forceClose();
+            numReaped_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // due on the tick that passes its deadline
+            size_t ticks = static_cast<size_t>(std::ceil((timeout_ - idle) / tick_));
+            ticks = std::min(std::max(ticks, size_t{1}), buckets_.size());
+            buckets_[(current_ + ticks - 1) % buckets_.size()].push_back(id);
+        }
+    }
+    scratch_.clear();
+}
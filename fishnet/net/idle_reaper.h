@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/callbacks.h"
+#include "fishnet/net/timer_id.h"
+
+namespace fishnet {
+
+namespace net {
+
+class ConnectionTable;
+class EventLoop;
+
+///
+/// Force closes the connections of one EventLoop that stay idle longer than
+/// a timeout.
+///
+/// Connections are kept by id in a ring of kNumBuckets + 1 buckets, one
+/// bucket per tick of timeout / kNumBuckets, and looked up in the
+/// ConnectionTable of the loop when due, so a closed connection isn't held
+/// until then. Nothing is touched when a connection has traffic,
+/// TcpConnection only records the time. When the bucket of a connection comes
+/// due, it's closed if idle for the timeout by then, or moved to the bucket of
+/// its new deadline. So a connection is closed within
+/// timeout * (1 + 1 / kNumBuckets) after its last activity.
+///
+/// This is an internal class of TcpServer, all but numReaped() in loop thread.
+class IdleReaper : noncopyable, public std::enable_shared_from_this<IdleReaper> {
+public:
+    static const int kNumBuckets = 8;
+
+    IdleReaper(EventLoop* loop, const ConnectionTable* connections, double timeoutSeconds);
+    ~IdleReaper();
+
+    /// Starts ticking, thread safe.
+    void start();
+
+    /// Stops ticking, thread safe.
+    void stop();
+
+    /// Watches an established connection of this loop.
+    void add(const TcpConnectionPtr& conn);
+
+    /// Connections closed so far, thread safe.
+    int64_t numReaped() const {
+        return numReaped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Bucket = std::vector<uint64_t>;  // connection ids
+
+    void onTick();
+
+    EventLoop* loop_;
+    const ConnectionTable* connections_;
+    const double timeout_;
+    const double tick_;
+    TimerId timerId_;
+    std::vector<Bucket> buckets_;
+    size_t current_;  // bucket due at the next tick
+    Bucket scratch_;
+    std::atomic<int64_t> numReaped_;
+};
+
+}  // namespace net
+}  // namespace fishnet
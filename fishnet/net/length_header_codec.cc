@@ -0,0 +1,77 @@
+#include "fishnet/net/length_header_codec.h"
+
+#include <cstring>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/net/buffer.h"
+#include "fishnet/net/endian.h"
+#include "fishnet/net/tcp_connection.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const size_t LengthHeaderCodec::kHeaderLen;
+const int32_t LengthHeaderCodec::kDefaultMaxFrameSize;
+
+namespace {
+
+void defaultErrorCallback(const TcpConnectionPtr& conn, int32_t length) {
+    LOG_ERROR << "LengthHeaderCodec - invalid length " << length << " from "
+              << conn->name();
+    conn->forceClose();
+}
+
+}  // namespace
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameCallback& cb, int32_t maxFrameSize)
+    : frameCallback_(cb), errorCallback_(defaultErrorCallback), maxFrameSize_(maxFrameSize) {
+    assert(maxFrameSize_ >= 0);
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf,
+                                  Timestamp receiveTime) {
+    // walk the frames in place, retrieve them all at once
+    const char* frame = buf->peek();
+    const char* const end = buf->beginWrite();
+    while (static_cast<size_t>(end - frame) >= kHeaderLen) {
+        uint32_t be32 = 0;
+        ::memcpy(&be32, frame, sizeof(be32));
+        const int32_t len = static_cast<int32_t>(sockets::networkToHost32(be32));
+        if (len < 0 || len > maxFrameSize_) {
+            buf->retrieveAll();
+            errorCallback_(conn, len);
+            return;
+        }
+        const size_t frameLen = kHeaderLen + static_cast<size_t>(len);
+        if (static_cast<size_t>(end - frame) < frameLen) {
+            break;
+        }
+        frameCallback_(conn, StringPiece(frame + kHeaderLen, len), receiveTime);
+        frame += frameLen;
+    }
+    buf->retrieve(static_cast<size_t>(frame - buf->peek()));
+}
+
+void LengthHeaderCodec::encode(Buffer* buf) {
+    size_t len = buf->readableBytes();
+    assert(len <= static_cast<size_t>(INT32_MAX));
+    if (buf->prependableBytes() < kHeaderLen) {
+        // its cheap prepend space is used up, copy once
+        Buffer framed{len};
+        framed.append(buf->peek(), len);
+        buf->swap(framed);
+    }
+    buf->prependInt32(static_cast<int32_t>(len));
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, Buffer* message) const {
+    assert(message->readableBytes() <= static_cast<size_t>(maxFrameSize_));
+    encode(message);
+    conn->send(message);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, const StringPiece& message) const {
+    Buffer buf{static_cast<size_t>(message.size())};
+    buf.append(message.data(), static_cast<size_t>(message.size()));
+    send(conn, &buf);
+}
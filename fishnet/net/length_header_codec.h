@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/base/string_piece.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/callbacks.h"
+
+namespace fishnet {
+
+namespace net {
+
+class Buffer;
+
+///
+/// Frames of a 4 bytes big endian length header followed by that many bytes.
+///
+/// Installed as the MessageCallback, onMessage() walks the complete frames
+/// in the input buffer of the connection in one pass and hands each out as
+/// a view into that buffer, retrieving them all at once afterwards. A view
+/// is only valid during the FrameCallback, copy what must outlive it.
+///
+/// Outgoing frames get their header in the kCheapPrepend space of the
+/// Buffer holding the message, so encoding moves no payload byte.
+///
+/// Stateless but for its callbacks, one codec can serve many connections.
+class LengthHeaderCodec : noncopyable {
+public:
+    using FrameCallback =
+        std::function<void(const TcpConnectionPtr&, StringPiece frame, Timestamp)>;
+    /// A header out of [0, maxFrameSize], the stream can't be resynchronized.
+    using ErrorCallback = std::function<void(const TcpConnectionPtr&, int32_t length)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const int32_t kDefaultMaxFrameSize = 64 * 1024 * 1024;
+
+    explicit LengthHeaderCodec(const FrameCallback& cb,
+                               int32_t maxFrameSize = kDefaultMaxFrameSize);
+
+    /// Replaces the default of logging and force closing the connection.
+    void setErrorCallback(const ErrorCallback& cb) {
+        errorCallback_ = cb;
+    }
+
+    int32_t maxFrameSize() const {
+        return maxFrameSize_;
+    }
+
+    /// The MessageCallback of the connections speaking this protocol.
+    /// The FrameCallback mustn't touch @c buf.
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    /// Turns the readable bytes of @c buf into one frame, in place.
+    static void encode(Buffer* buf);
+
+    /// Sends the readable bytes of @c message as one frame, @c message is
+    /// left empty. Use it with a Buffer built for the purpose.
+    void send(const TcpConnectionPtr& conn, Buffer* message) const;
+
+    /// Sends @c message as one frame, copied once into a Buffer.
+    void send(const TcpConnectionPtr& conn, const StringPiece& message) const;
+
+private:
+    FrameCallback frameCallback_;
+    ErrorCallback errorCallback_;
+    const int32_t maxFrameSize_;
+};
+
+}  // namespace net
+}  // namespace fishnet
@@ -0,0 +1,160 @@
+#include "fishnet/net/output_queue.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/types.h"
+#include "fishnet/net/sockets_ops.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const size_t OutputQueue::kMinSliceSize;
+const int OutputQueue::kMaxIovecs;
+
+namespace {
+
+// sendfile(2) transfers at most 0x7ffff000 bytes per call
+const size_t kMaxSendfileBytes = 0x7ffff000;
+
+}  // namespace
+
+OutputQueue::~OutputQueue() {
+    retrieveAll();
+}
+
+void OutputQueue::append(const char* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    buffer_.append(data, len);
+    if (!slices_.empty() && !slices_.back().owner && slices_.back().fd < 0) {
+        slices_.back().len += len;
+    } else {
+        slices_.push_back(Slice{std::shared_ptr<const void>(), NULL, len, -1, 0});
+    }
+    bytes_ += len;
+}
+
+void OutputQueue::append(const std::shared_ptr<const void>& owner, const char* data,
+                         size_t len) {
+    if (!owner || len < kMinSliceSize) {
+        append(data, len);
+        return;
+    }
+    slices_.push_back(Slice{owner, data, len, -1, 0});
+    bytes_ += len;
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t len) {
+    if (len == 0) {
+        sockets::close(fd);
+        return;
+    }
+    slices_.push_back(Slice{std::shared_ptr<const void>(), NULL, len, fd, offset});
+    bytes_ += len;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int* savedErrno) {
+    assert(!slices_.empty());
+    if (slices_.front().fd >= 0) {
+        return sendFile(fd, &slices_.front(), savedErrno);
+    }
+
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = 0;
+    // bytes of consecutive buffer-backed slices are contiguous in buffer_
+    const char* bufferData = buffer_.peek();
+    for (const Slice& slice : slices_) {
+        if (iovcnt == kMaxIovecs || slice.fd >= 0) {
+            break;
+        }
+        if (slice.owner) {
+            vec[iovcnt].iov_base = const_cast<char*>(slice.data);
+        } else {
+            vec[iovcnt].iov_base = const_cast<char*>(bufferData);
+            bufferData += slice.len;
+        }
+        vec[iovcnt].iov_len = slice.len;
+        ++iovcnt;
+    }
+
+    const ssize_t n = sockets::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(implicit_cast<size_t>(n));
+    }
+    return n;
+}
+
+ssize_t OutputQueue::sendFile(int fd, Slice* slice, int* savedErrno) {
+    off_t offset = slice->offset;
+    const ssize_t n =
+        sockets::sendfile(fd, slice->fd, &offset, std::min(slice->len, kMaxSendfileBytes));
+    if (n < 0) {
+        *savedErrno = errno;
+        if (*savedErrno != EWOULDBLOCK && *savedErrno != EPIPE && *savedErrno != ECONNRESET) {
+            // the socket is fine but the file can't be sent, it would fail
+            // the same way on every POLLOUT, drop it and go on with the rest
+            LOG_SYSERR << "OutputQueue::sendFile fd = " << slice->fd;
+            bytes_ -= slice->len;
+            popFront();
+            return 0;
+        }
+    } else if (n == 0) {
+        // the file was truncated after being queued, nothing more to send
+        LOG_ERROR << "OutputQueue::sendFile fd = " << slice->fd << " ends " << slice->len
+                  << " bytes early";
+        bytes_ -= slice->len;
+        popFront();
+    } else {
+        retrieve(implicit_cast<size_t>(n));
+    }
+    return n;
+}
+
+void OutputQueue::retrieve(size_t len) {
+    assert(len <= bytes_);
+    bytes_ -= len;
+    while (len > 0) {
+        assert(!slices_.empty());
+        Slice& front = slices_.front();
+        size_t n = std::min(len, front.len);
+        if (front.fd >= 0) {
+            front.offset += static_cast<off_t>(n);
+        } else if (front.owner) {
+            front.data += n;
+        } else {
+            buffer_.retrieve(n);
+        }
+        front.len -= n;
+        len -= n;
+        if (front.len == 0) {
+            popFront();
+        }
+    }
+}
+
+void OutputQueue::retrieveAll() {
+    for (const Slice& slice : slices_) {
+        if (slice.fd >= 0) {
+            sockets::close(slice.fd);
+        }
+    }
+    buffer_.retrieveAll();
+    slices_.clear();
+    bytes_ = 0;
+}
+
+void OutputQueue::popFront() {
+    if (slices_.front().fd >= 0) {
+        sockets::close(slices_.front().fd);
+    }
+    slices_.pop_front();
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <deque>
+#include <memory>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/net/buffer.h"
+
+namespace fishnet {
+
+namespace net {
+
+///
+/// Bytes waiting to be written to a socket, in order.
+///
+/// Small writes are copied into a contiguous Buffer, large payloads owned by
+/// a refcounted object are queued by reference and never copied. File
+/// regions are queued as (fd, offset, len) and sent with sendfile(2), memory
+/// slices in between are flushed with writev(2).
+///
+/// @code
+/// +-----------+-----------------+-----------+-------------+-----------+
+/// | buffer    | slice of owner1 | buffer    | file region | buffer    | ...
+/// +-----------+-----------------+-----------+-------------+-----------+
+/// @endcode
+class OutputQueue : noncopyable {
+public:
+    /// Payloads shorter than this are copied, so a queue of tiny slices
+    /// doesn't degrade writev(2) into many small iovecs.
+    static const size_t kMinSliceSize = 1024;
+
+    /// At most this many iovecs are handed to a single writev(2).
+    static const int kMaxIovecs = 64;
+
+    OutputQueue() : bytes_(0) {}
+    ~OutputQueue();
+
+    size_t readableBytes() const {
+        return bytes_;
+    }
+
+    bool empty() const {
+        return bytes_ == 0;
+    }
+
+    /// Copies [data, data+len) into the queue.
+    void append(const char* data, size_t len);
+
+    /// Queues [data, data+len) by reference, @c owner keeps it alive until
+    /// the bytes are written or the queue is destroyed.
+    void append(const std::shared_ptr<const void>& owner, const char* data, size_t len);
+
+    /// Queues @c len bytes of file @c fd starting at @c offset.
+    /// Takes the ownership of @c fd, it's closed once the region is written
+    /// or the queue is destroyed.
+    void appendFile(int fd, off_t offset, size_t len);
+
+    /// Writes as much as possible of the memory slices with writev(2), or of
+    /// the file region at the front with sendfile(2).
+    /// A file region that ends early or can't be read is dropped as if it
+    /// were written, and 0 is returned.
+    /// @return result of writev(2) or sendfile(2), @c errno is saved
+    ssize_t writeFd(int fd, int* savedErrno);
+
+    /// Drops @c len bytes from the front of the queue.
+    void retrieve(size_t len);
+
+    void retrieveAll();
+
+    /// Storage of the copied bytes.
+    Buffer* buffer() {
+        return &buffer_;
+    }
+    const Buffer* buffer() const {
+        return &buffer_;
+    }
+
+private:
+    struct Slice {
+        std::shared_ptr<const void> owner;  // NULL if bytes live in buffer_
+        const char* data;
+        size_t len;
+        int fd;  // -1 unless it's a file region
+        off_t offset;
+    };
+
+    ssize_t sendFile(int fd, Slice* slice, int* savedErrno);
+    void popFront();
+
+    Buffer buffer_;
+    std::deque<Slice> slices_;
+    size_t bytes_;
+};
+
+}  // namespace net
+}  // namespace fishnet
\ No newline at end of file
@@ -37,6 +37,11 @@ public:
 
     virtual bool hasChannel(Channel* channel) const;
 
+    /// Whether Channel::setEdgeTriggered() is honored.
+    virtual bool supportsEdgeTriggered() const {
+        return false;
+    }
+
     static Poller* newDefaultPoller(EventLoop* loop);
 
     void assertInLoopThread() const {
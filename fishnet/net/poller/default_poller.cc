@@ -1,15 +1,26 @@
 #include <cstdlib>
 
+#include "fishnet/base/logging.h"
 #include "fishnet/net/poller.h"
 #include "fishnet/net/poller/epoll_poller.h"
 #include "fishnet/net/poller/poll_poller.h"
+#ifndef NO_IO_URING
+#include "fishnet/net/poller/io_uring_poller.h"
+#endif
 
 using namespace fishnet::net;
 
 Poller* Poller::newDefaultPoller(EventLoop* loop) {
     if (::getenv("FISHNET_USE_POLL")) {
         return new PollPoller(loop);
-    } else {
-        return new EPollPoller(loop);
     }
+    if (::getenv("FISHNET_USE_IO_URING")) {
+#ifndef NO_IO_URING
+        if (IoUringPoller::isSupported()) {
+            return new IoUringPoller(loop);
+        }
+#endif
+        LOG_WARN << "io_uring is not available, fall back to epoll";
+    }
+    return new EPollPoller(loop);
 }
\ No newline at end of file
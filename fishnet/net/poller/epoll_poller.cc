@@ -140,7 +140,10 @@ void EPollPoller::removeChannel(Channel* channel) {
 void EPollPoller::update(int operation, Channel* channel) {
     struct epoll_event event;
     memZero(&event, sizeof(event));
-    event.events = channel->events();
+    event.events = static_cast<uint32_t>(channel->registeredEvents());
+    if (channel->edgeTriggered()) {
+        event.events |= EPOLLET;
+    }
     event.data.ptr = channel;
     int fd = channel->fd();
     LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
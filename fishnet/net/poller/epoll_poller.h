@@ -24,6 +24,10 @@ public:
 
     void removeChannel(Channel* channel) override;
 
+    bool supportsEdgeTriggered() const override {
+        return true;
+    }
+
 private:
     static const int kInitEventListSize = 16;
 
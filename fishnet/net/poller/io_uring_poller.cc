@@ -0,0 +1,388 @@
+#include "fishnet/net/poller/io_uring_poller.h"
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/base/types.h"
+#include "fishnet/net/channel.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/poller.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+namespace {
+
+const int kNew = -1;
+const int kAdded = 1;
+const int kDeleted = 2;
+
+// user_data of requests whose completion carries no channel
+const uint64_t kTimeoutData = ~0ULL;
+const uint64_t kRemoveData = ~0ULL - 1;
+
+int ioUringSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+inline uint64_t makeUserData(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(fd) << 32) | generation;
+}
+
+template <typename T>
+T* ringAt(void* ring, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop),
+      ringFd_(-1),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqHead_(NULL),
+      sqTail_(NULL),
+      sqRingMask_(NULL),
+      sqEntries_(0),
+      sqArray_(NULL),
+      sqes_(NULL),
+      sqesSize_(0),
+      sqeTail_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      cqHead_(NULL),
+      cqTail_(NULL),
+      cqRingMask_(NULL),
+      cqes_(NULL),
+      nextGeneration_(1),
+      timeoutArmed_(false),
+      timeout_(new __kernel_timespec) {
+    setupRings();
+}
+
+IoUringPoller::~IoUringPoller() {
+    ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    ::munmap(sqRing_, sqRingSize_);
+    ::close(ringFd_);
+}
+
+bool IoUringPoller::isSupported() {
+    static const bool supported = [] {
+        struct io_uring_params p;
+        memZero(&p, sizeof(p));
+        int fd = ioUringSetup(1, &p);
+        if (fd < 0) {
+            return false;
+        }
+        ::close(fd);
+        return true;
+    }();
+    return supported;
+}
+
+void IoUringPoller::setupRings() {
+    struct io_uring_params p;
+    memZero(&p, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = kRingEntries * 4;
+    ringFd_ = ioUringSetup(kRingEntries, &p);
+    if (ringFd_ < 0) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller";
+    }
+    if (!(p.features & IORING_FEAT_NODROP)) {
+        LOG_WARN << "IoUringPoller: kernel may drop completions on CQ overflow";
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller mmap sq ring";
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = ::mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            LOG_SYSFATAL << "IoUringPoller mmap cq ring";
+        }
+    }
+
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller mmap sqes";
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    sqHead_ = ringAt<unsigned>(sqRing_, p.sq_off.head);
+    sqTail_ = ringAt<unsigned>(sqRing_, p.sq_off.tail);
+    sqRingMask_ = ringAt<unsigned>(sqRing_, p.sq_off.ring_mask);
+    sqArray_ = ringAt<unsigned>(sqRing_, p.sq_off.array);
+    sqEntries_ = p.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    cqHead_ = ringAt<unsigned>(cqRing_, p.cq_off.head);
+    cqTail_ = ringAt<unsigned>(cqRing_, p.cq_off.tail);
+    cqRingMask_ = ringAt<unsigned>(cqRing_, p.cq_off.ring_mask);
+    cqes_ = ringAt<struct io_uring_cqe>(cqRing_, p.cq_off.cqes);
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels) {
+    LOG_TRACE << "fd total count " << channels_.size();
+    armPending();
+
+    int ret = 0;
+    const bool ready = *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    if (!ready && timeoutMs != 0) {
+        if (timeoutMs > 0 && !timeoutArmed_) {
+            prepTimeout(timeoutMs);
+        }
+        ret = submit(1);
+    } else if (sqeTail_ != *sqTail_) {
+        ret = submit(0);
+    }
+    int savedErrno = errno;
+    Timestamp now{Timestamp::now()};
+
+    size_t before = activeChannels->size();
+    fillActiveChannels(activeChannels);
+    size_t numEvents = activeChannels->size() - before;
+    if (numEvents > 0) {
+        LOG_TRACE << numEvents << " events happended";
+    } else if (ret >= 0) {
+        LOG_TRACE << "nothing happended";
+    } else if (savedErrno != EINTR) {
+        errno = savedErrno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+    return now;
+}
+
+void IoUringPoller::updateChannel(Channel* channel) {
+    Poller::assertInLoopThread();
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd << " events = " << channel->events() << " index = " << index;
+    if (index == kNew || index == kDeleted) {
+        if (index == kNew) {
+            assert(channels_.find(fd) == channels_.end());
+            channels_[fd] = channel;
+        } else {
+            assert(channels_.find(fd) != channels_.end());
+            assert(channels_[fd] == channel);
+        }
+        channel->setIndex(kAdded);
+        if (implicit_cast<size_t>(fd) >= requests_.size()) {
+            requests_.resize(std::max(requests_.size() * 2, implicit_cast<size_t>(fd) + 1));
+        }
+        requests_[fd].channel = channel;
+        queueArm(fd);
+    } else {
+        assert(channels_.find(fd) != channels_.end());
+        assert(channels_[fd] == channel);
+        assert(index == kAdded);
+        PollRequest* req = requestOf(fd);
+        if (req->armed && req->events == channel->events()) {
+            return;
+        }
+        if (req->armed) {
+            prepPollRemove(req, fd);
+        }
+        if (channel->isNoneEvent()) {
+            channel->setIndex(kDeleted);
+        } else {
+            queueArm(fd);
+        }
+    }
+}
+
+void IoUringPoller::removeChannel(Channel* channel) {
+    Poller::assertInLoopThread();
+    int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd;
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+    assert(channel->isNoneEvent());
+    int index = channel->index();
+    assert(index == kAdded || index == kDeleted);
+    size_t n = channels_.erase(fd);
+    (void)n;
+    assert(n == 1);
+
+    PollRequest* req = requestOf(fd);
+    if (req->armed) {
+        prepPollRemove(req, fd);
+    }
+    req->channel = NULL;
+    channel->setIndex(kNew);
+}
+
+io_uring_sqe* IoUringPoller::getSqe() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_) {
+        // ring is full, hand what we have to the kernel without waiting
+        submit(0);
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqeTail_ - head >= sqEntries_) {
+            LOG_FATAL << "IoUringPoller submission queue overflow";
+        }
+    }
+    unsigned idx = sqeTail_ & *sqRingMask_;
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    memZero(sqe, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    ++sqeTail_;
+    return sqe;
+}
+
+int IoUringPoller::submit(unsigned minComplete) {
+    unsigned toSubmit = sqeTail_ - *sqTail_;
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret = ioUringEnter(ringFd_, toSubmit, minComplete, flags);
+    if (ret < 0 && errno != EINTR && errno != EBUSY) {
+        LOG_SYSERR << "IoUringPoller::submit";
+    }
+    return ret;
+}
+
+void IoUringPoller::armPending() {
+    for (int fd : pendingArms_) {
+        PollRequest* req = requestOf(fd);
+        req->pending = false;
+        Channel* channel = req->channel;
+        if (channel != NULL && !req->armed && !channel->isNoneEvent()) {
+            prepPollAdd(channel, req);
+        }
+    }
+    pendingArms_.clear();
+}
+
+void IoUringPoller::prepPollAdd(Channel* channel, PollRequest* req) {
+    if (++nextGeneration_ == 0) {
+        ++nextGeneration_;
+    }
+    req->generation = nextGeneration_;
+    req->events = channel->events();
+    req->armed = true;
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = channel->fd();
+    sqe->poll32_events = static_cast<uint32_t>(channel->events());
+    sqe->user_data = makeUserData(channel->fd(), req->generation);
+    LOG_TRACE << "io_uring poll add fd = " << channel->fd() << " event = { "
+              << channel->eventsToString() << " }";
+}
+
+void IoUringPoller::prepPollRemove(PollRequest* req, int fd) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, req->generation);
+    sqe->user_data = kRemoveData;
+    // completions still carrying the old generation are ignored
+    req->generation = 0;
+    req->armed = false;
+    LOG_TRACE << "io_uring poll remove fd = " << fd;
+}
+
+void IoUringPoller::prepTimeout(int timeoutMs) {
+    timeout_->tv_sec = timeoutMs / 1000;
+    timeout_->tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(timeout_.get());
+    sqe->len = 1;
+    // fires after any other completion as well, so it never outlives a wakeup
+    sqe->off = 1;
+    sqe->user_data = kTimeoutData;
+    timeoutArmed_ = true;
+}
+
+void IoUringPoller::queueArm(int fd) {
+    PollRequest* req = requestOf(fd);
+    if (!req->pending) {
+        req->pending = true;
+        pendingArms_.push_back(fd);
+    }
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels) {
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe* cqe = &cqes_[head & *cqRingMask_];
+        const uint64_t data = cqe->user_data;
+        if (data == kTimeoutData) {
+            timeoutArmed_ = false;
+            continue;
+        }
+        if (data == kRemoveData) {
+            continue;
+        }
+
+        int fd = static_cast<int>(data >> 32);
+        uint32_t generation = static_cast<uint32_t>(data);
+        PollRequest* req = requestOf(fd);
+        if (req == NULL || !req->armed || req->generation != generation) {
+            continue;  // stale completion of a removed or re-armed request
+        }
+        // one-shot request, re-armed on the next poll()
+        req->armed = false;
+        Channel* channel = req->channel;
+        assert(channel != NULL);
+#ifndef NDEBUG
+        auto it = channels_.find(fd);
+        assert(it != channels_.end());
+        assert(it->second == channel);
+#endif
+        queueArm(fd);
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) {
+                errno = -cqe->res;
+                LOG_SYSERR << "IoUringPoller poll fd = " << fd;
+            }
+            continue;
+        }
+        channel->setRevents(cqe->res);
+        activeChannels->push_back(channel);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+IoUringPoller::PollRequest* IoUringPoller::requestOf(int fd) {
+    if (fd < 0 || implicit_cast<size_t>(fd) >= requests_.size()) {
+        return NULL;
+    }
+    return &requests_[fd];
+}
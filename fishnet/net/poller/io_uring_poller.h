@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/channel.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/poller.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct __kernel_timespec;
+
+namespace fishnet {
+
+namespace net {
+
+///
+/// IO Multiplexing with io_uring.
+///
+/// Every interested Channel owns one poll request inside the ring. Arming,
+/// re-arming and removing requests only fills submission entries; they are
+/// all handed to the kernel by the single io_uring_enter(2) that also waits
+/// for completions, so one loop iteration costs one syscall no matter how
+/// many fds are ready or changed their interest.
+///
+/// Poll requests are one-shot and re-armed after they fire, which keeps the
+/// level-triggered semantics Channel and TcpConnection rely on.
+class IoUringPoller : public Poller {
+public:
+    IoUringPoller(EventLoop* loop);
+    ~IoUringPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+
+    void updateChannel(Channel* channel) override;
+
+    void removeChannel(Channel* channel) override;
+
+    /// false if the kernel refuses io_uring_setup(2), e.g. ENOSYS or EPERM.
+    static bool isSupported();
+
+private:
+    static const unsigned kRingEntries = 4096;
+
+    struct PollRequest {
+        PollRequest() : channel(NULL), events(0), generation(0), armed(false), pending(false) {}
+
+        Channel* channel;
+        int events;           // interest of the in-flight request
+        uint32_t generation;  // tags the in-flight request
+        bool armed;           // a poll request is in the ring
+        bool pending;         // queued in pendingArms_
+    };
+
+    void setupRings();
+    io_uring_sqe* getSqe();
+    int submit(unsigned minComplete);
+    void armPending();
+    void prepPollAdd(Channel* channel, PollRequest* req);
+    void prepPollRemove(PollRequest* req, int fd);
+    void prepTimeout(int timeoutMs);
+    void queueArm(int fd);
+    void fillActiveChannels(ChannelList* activeChannels);
+    PollRequest* requestOf(int fd);
+
+    int ringFd_;
+
+    // submission queue, mapped from the ring fd
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqRingMask_;
+    unsigned sqEntries_;
+    unsigned* sqArray_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned sqeTail_;  // local tail, published on submit()
+
+    // completion queue, may share the mapping with the submission queue
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqRingMask_;
+    io_uring_cqe* cqes_;
+
+    uint32_t nextGeneration_;
+    bool timeoutArmed_;
+    std::unique_ptr<__kernel_timespec> timeout_;
+    std::vector<PollRequest> requests_;  // indexed by fd
+    std::vector<int> pendingArms_;
+};
+
+}  // namespace net
+}  // namespace fishnet
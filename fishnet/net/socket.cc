@@ -80,6 +80,13 @@ void Socket::setTcpNoDelay(bool on) {
     // FIXME check
 }
 
+void Socket::setTcpCork(bool on) {
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_CORK, &optval,
+                 static_cast<socklen_t>(sizeof(optval)));
+    // FIXME check
+}
+
 void Socket::setReuseAddr(bool on) {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &optval,
@@ -107,4 +114,17 @@ void Socket::setKeepAlive(bool on) {
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval,
                  static_cast<socklen_t>(sizeof(optval)));
     // FIXME check
+}
+
+void Socket::setIncomingCpu(int cpu) {
+#ifdef SO_INCOMING_CPU
+    int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu,
+                           static_cast<socklen_t>(sizeof(cpu)));
+    if (ret < 0) {
+        LOG_SYSERR << "SO_INCOMING_CPU failed.";
+    }
+#else
+    (void)cpu;
+    LOG_ERROR << "SO_INCOMING_CPU is not supported.";
+#endif
 }
\ No newline at end of file
@@ -41,6 +41,9 @@ public:
     /// Enable/disable TCP_NODELAY (disable/enable Nagle's algorithm)
     void setTcpNoDelay(bool on);
 
+    /// Enable/disable TCP_CORK, disabling it sends the partial frame held back
+    void setTcpCork(bool on);
+
     /// Enable/disable SO_REUSEADDR
     void setReuseAddr(bool on);
 
@@ -50,6 +53,10 @@ public:
     /// Enable/disable SO_KEEPALIVE
     void setKeepAlive(bool on);
 
+    /// SO_INCOMING_CPU, among SO_REUSEPORT listeners the kernel prefers the
+    /// one set to the CPU that received the connection
+    void setIncomingCpu(int cpu);
+
 private:
     const int sockfd_;
 };
@@ -3,8 +3,9 @@
 #include <asm-generic/errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 #include <cassert>
@@ -64,20 +65,22 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr) {
 #endif
     if (connfd < 0) {
         int savedErrno = errno;
-        LOG_SYSERR << "Socket::accept";
         switch (savedErrno) {
             case EAGAIN:
+                // the listen queue is drained, not an error
+                break;
             case ECONNABORTED:
             case EINTR:
             case EPROTO:
             case EPERM:
             case EMFILE:
+            case ENFILE:
+                LOG_SYSERR << "Socket::accept";
                 errno = savedErrno;
                 break;
             case EBADF:
             case EFAULT:
             case EINVAL:
-            case ENFILE:
             case ENOBUFS:
             case ENOMEM:
             case ENOTSOCK:
@@ -104,6 +107,14 @@ ssize_t sockets::write(int sockfd, const void* buf, size_t count) {
     return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec* iov, int iovcnt) {
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int fd, off_t* offset, size_t count) {
+    return ::sendfile(sockfd, fd, offset, count);
+}
+
 void sockets::close(int sockfd) {
     if (::close(sockfd) < 0) {
         LOG_SYSERR << "sockets::close";
@@ -172,6 +183,20 @@ int sockets::getSocketError(int sockfd) {
     }
 }
 
+int sockets::getIncomingCpu(int sockfd) {
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t optlen = static_cast<socklen_t>(sizeof(cpu));
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0) {
+        return -1;
+    }
+    return cpu;
+#else
+    (void)sockfd;
+    return -1;
+#endif
+}
+
 const struct sockaddr* sockets::sockaddr_cast(const struct sockaddr_in* addr) {
     return static_cast<const struct sockaddr*>(implicit_cast<const void*>(addr));
 }
@@ -20,6 +20,8 @@ int accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void* buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec* iov, int iovcnt);
 ssize_t write(int sockfd, const void* buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec* iov, int iovcnt);
+ssize_t sendfile(int sockfd, int fd, off_t* offset, size_t count);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -30,6 +32,9 @@ void fromIpPort(const char* ip, uint16_t port, struct sockaddr_in* addr);
 void fromIpPort(const char* ip, uint16_t port, struct sockaddr_in6* addr);
 
 int getSocketError(int sockfd);
+/// The CPU that handled the last packet of the socket, SO_INCOMING_CPU,
+/// -1 if unknown
+int getIncomingCpu(int sockfd);
 
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in* addr);
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in6* addr);
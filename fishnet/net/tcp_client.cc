@@ -98,16 +98,15 @@ void TcpClient::stop() {
 void TcpClient::newConnection(int sockfd) {
     loop_->assertInLoopThread();
     InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+    int connId = nextConnId_++;
     char buf[32];
-    snprintf(buf, sizeof(buf), ":%s#%d", peerAddr.toIpPort().c_str(),
-             nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof(buf), ":%s#%d", peerAddr.toIpPort().c_str(), connId);
     string connName = name_ + buf;
 
     InetAddress localAddr{sockets::getLocalAddr(sockfd)};
 
-    TcpConnectionPtr conn{
-        new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr)};
+    TcpConnectionPtr conn{new TcpConnection(loop_, connName, sockfd, localAddr,
+                                            peerAddr, static_cast<uint64_t>(connId))};
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
@@ -1,8 +1,10 @@
 #include "fishnet/net/tcp_connection.h"
 
 #include <asm-generic/errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 
@@ -20,6 +22,11 @@
 using namespace fishnet;
 using namespace fishnet::net;
 
+const size_t TcpConnection::kMinReadSize;
+const size_t TcpConnection::kMaxReadSize;
+const size_t TcpConnection::kIdleBufferCapacity;
+const int TcpConnection::kMaxEdgeTriggeredReads;
+
 void fishnet::net::defaultConnectionCallback(const TcpConnectionPtr& conn) {
     LOG_TRACE << conn->localAddress().toIpPort() << " -> "
               << conn->peerAddress().toIpPort() << " is "
@@ -34,39 +41,71 @@ void fishnet::net::defaultMessageCallback(const TcpConnectionPtr& conn,
 
 TcpConnection::TcpConnection(EventLoop* loop, const string& nameArg, int sockfd,
                              const InetAddress& localAddr,
-                             const InetAddress& peerAddr)
+                             const InetAddress& peerAddr, uint64_t id)
+    : TcpConnection(loop, nameArg, std::shared_ptr<const string>(), sockfd, localAddr,
+                    peerAddr, id) {}
+
+TcpConnection::TcpConnection(EventLoop* loop, const std::shared_ptr<const string>& namePrefix,
+                             int sockfd, const InetAddress& localAddr,
+                             const InetAddress& peerAddr, uint64_t id)
+    : TcpConnection(loop, string(), namePrefix, sockfd, localAddr, peerAddr, id) {}
+
+TcpConnection::TcpConnection(EventLoop* loop, const string& nameArg,
+                             const std::shared_ptr<const string>& namePrefix, int sockfd,
+                             const InetAddress& localAddr, const InetAddress& peerAddr,
+                             uint64_t id)
     : loop_(CHECK_NOTNULL(loop)),
       name_(nameArg),
+      namePrefix_(namePrefix),
+      id_(id),
       state_(StateE::kConnecting),
       reading_(true),
-      socket_(new Socket{sockfd}),
-      channel_(new Channel{loop, sockfd}),
+      socket_(sockfd),
+      channel_(loop, sockfd),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) {
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, _1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
-    LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at " << this
+      highWaterMark_(64 * 1024 * 1024),
+      coalesceWrites_(false),
+      corkWrites_(false),
+      flushQueued_(false),
+      readSize_(kMinReadSize),
+      smallReads_(0),
+      reportedBufferBytes_(0) {
+    // counted from now on, not from connectEstablished(), so that loop
+    // selection sees a burst of new connections
+    loop_->addConnections(1);
+    channel_.setReadCallback(std::bind(&TcpConnection::handleRead, this, _1));
+    channel_.setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
+    channel_.setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+    channel_.setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    LOG_DEBUG << "TcpConnection::ctor[" << name() << "] at " << this
               << " fd=" << sockfd;
-    socket_->setKeepAlive(true);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection() {
-    LOG_DEBUG << "TcpConnection::dtor[" << name_ << "] at " << this
-              << " fd=" << channel_->fd() << " state=" << stateToString();
+    LOG_DEBUG << "TcpConnection::dtor[" << name() << "] at " << this
+              << " fd=" << channel_.fd() << " state=" << stateToString();
     assert(state_ == StateE::kDisconnected);
+    if (bufferBytesCounter_) {
+        bufferBytesCounter_->add(-reportedBufferBytes_);
+    }
+}
+
+void TcpConnection::buildName() const {
+    name_ = *namePrefix_;
+    name_ += '#';
+    name_ += std::to_string(id_);
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const {
-    return socket_->getTcpInfo(tcpi);
+    return socket_.getTcpInfo(tcpi);
 }
 
 string TcpConnection::getTcpInfoString() const {
     char buf[1024];
     buf[0] = '\0';
-    socket_->getTcpInfoString(buf, sizeof(buf));
+    socket_.getTcpInfoString(buf, sizeof(buf));
     return buf;
 }
 
@@ -79,10 +118,20 @@ void TcpConnection::send(const StringPiece& message) {
         if (loop_->isInLoopThread()) {
             sendInLoop(message);
         } else {
-            void (TcpConnection::*fp)(const StringPiece& message) =
-                &TcpConnection::sendInLoop;
-            // TODO: 存在bug?
-            loop_->runInLoop(std::bind(fp, this, message.toString()));
+            // the only copy, queued by reference afterwards
+            SharedPayload payload{std::make_shared<string>(message.data(), message.size())};
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, this, payload));
+        }
+    }
+}
+
+void TcpConnection::send(string&& message) {
+    if (state_ == StateE::kConnected) {
+        SharedPayload payload{std::make_shared<string>(std::move(message))};
+        if (loop_->isInLoopThread()) {
+            sendPayloadInLoop(payload);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, this, payload));
         }
     }
 }
@@ -93,9 +142,71 @@ void TcpConnection::send(Buffer* buf) {
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
         } else {
-            void (TcpConnection::*fp)(const StringPiece& message) =
-                &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(fp, this, buf->retrieveAllAsString()));
+            std::shared_ptr<Buffer> message{std::make_shared<Buffer>(0)};
+            message->swap(*buf);
+            loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, this, message));
+        }
+    }
+}
+
+void TcpConnection::send(const SharedPayload& message) {
+    if (state_ == StateE::kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendPayloadInLoop(message);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, this, message));
+        }
+    }
+}
+
+void TcpConnection::broadcast(const std::vector<TcpConnectionPtr>& conns,
+                              const SharedPayload& message) {
+    // few loops, a linear search beats a map
+    using Group = std::pair<EventLoop*, std::shared_ptr<std::vector<TcpConnectionPtr>>>;
+    std::vector<Group> groups;
+    for (const TcpConnectionPtr& conn : conns) {
+        auto it = std::find_if(groups.begin(), groups.end(), [&conn](const Group& group) {
+            return group.first == conn->getLoop();
+        });
+        if (it == groups.end()) {
+            groups.emplace_back(conn->getLoop(),
+                                std::make_shared<std::vector<TcpConnectionPtr>>());
+            it = groups.end() - 1;
+        }
+        it->second->push_back(conn);
+    }
+    for (const Group& group : groups) {
+        if (group.first->isInLoopThread()) {
+            broadcastInLoop(group.second, message);
+        } else {
+            group.first->queueInLoop(
+                std::bind(&TcpConnection::broadcastInLoop, group.second, message));
+        }
+    }
+}
+
+void TcpConnection::broadcastInLoop(
+    const std::shared_ptr<std::vector<TcpConnectionPtr>>& conns,
+    const SharedPayload& message) {
+    for (const TcpConnectionPtr& conn : *conns) {
+        if (conn->state_ == StateE::kConnected) {
+            conn->sendPayloadInLoop(message);
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len) {
+    if (state_ == StateE::kConnected) {
+        int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dupfd < 0) {
+            LOG_SYSERR << "TcpConnection::sendFile";
+            return;
+        }
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(dupfd, offset, len);
+        } else {
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendFileInLoop, this, dupfd, offset, len));
         }
     }
 }
@@ -104,7 +215,20 @@ void TcpConnection::sendInLoop(const StringPiece& message) {
     sendInLoop(message.data(), message.size());
 }
 
+void TcpConnection::sendPayloadInLoop(const SharedPayload& message) {
+    sendInLoop(message->data(), message->size(), message);
+}
+
+void TcpConnection::sendBufferInLoop(const std::shared_ptr<Buffer>& message) {
+    sendInLoop(message->peek(), message->readableBytes(), message);
+}
+
 void TcpConnection::sendInLoop(const void* data, size_t len) {
+    sendInLoop(data, len, std::shared_ptr<const void>());
+}
+
+void TcpConnection::sendInLoop(const void* data, size_t len,
+                               const std::shared_ptr<const void>& owner) {
     loop_->assertInLoopThread();
     ssize_t nwrote = 0;
     size_t remaining = len;
@@ -114,8 +238,8 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
         return;
     }
 
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        nwrote = sockets::write(channel_->fd(), data, len);
+    if (!coalesceWrites_ && !channel_.isWriting() && outputQueue_.empty()) {
+        nwrote = sockets::write(channel_.fd(), data, len);
         if (nwrote >= 0) {
             remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_) {
@@ -136,19 +260,144 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
 
     assert(remaining <= len);
     if (!faultError && remaining > 0) {
-        size_t oldLen = outputBuffer_.readableBytes();
+        size_t oldLen = outputQueue_.readableBytes();
         if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
             highWaterMarkCallback_) {
             loop_->queueInLoop(std::bind(highWaterMarkCallback_,
                                          shared_from_this(),
                                          oldLen + remaining));
         }
-        outputBuffer_.append(static_cast<const char*>(data) + nwrote,
-                             remaining);
-        if (!channel_->isWriting()) {
-            channel_->enableWriting();
+        // owner == NULL means caller's memory, which must be copied
+        outputQueue_.append(owner, static_cast<const char*>(data) + nwrote,
+                            remaining);
+        startWriting();
+        updateBufferBytes();
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len) {
+    loop_->assertInLoopThread();
+    ssize_t nwrote = 0;
+    size_t remaining = len;
+    bool faultError = false;
+    if (state_ == StateE::kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        sockets::close(fd);
+        return;
+    }
+
+    if (!coalesceWrites_ && !channel_.isWriting() && outputQueue_.empty()) {
+        off_t off = offset;
+        nwrote = sockets::sendfile(channel_.fd(), fd, &off, len);
+        if (nwrote == 0 && len > 0) {
+            // the file ends before offset + len, there's nothing to send
+            LOG_ERROR << "TcpConnection::sendFileInLoop fd = " << fd << " ends " << len
+                      << " bytes early";
+            remaining = 0;
+        } else if (nwrote >= 0) {
+            remaining = len - nwrote;
+        } else {
+            nwrote = 0;
+            if (errno != EWOULDBLOCK) {
+                LOG_SYSERR << "TcpConnection::sendFileInLoop";
+                if (errno == EPIPE || errno == ECONNRESET) {
+                    faultError = true;
+                } else {
+                    // the file can't be sent, queueing it would fail the
+                    // same way on every POLLOUT, drop it like a short file
+                    remaining = 0;
+                }
+            }
+        }
+        if (!faultError && remaining == 0 && writeCompleteCallback_) {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
     }
+
+    assert(remaining <= len);
+    if (!faultError && remaining > 0) {
+        size_t oldLen = outputQueue_.readableBytes();
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
+            highWaterMarkCallback_) {
+            loop_->queueInLoop(std::bind(highWaterMarkCallback_,
+                                         shared_from_this(),
+                                         oldLen + remaining));
+        }
+        outputQueue_.appendFile(fd, offset + nwrote, remaining);
+        startWriting();
+    } else {
+        sockets::close(fd);
+    }
+}
+
+void TcpConnection::startWriting() {
+    if (channel_.isWriting()) {
+        return;
+    }
+    if (!coalesceWrites_) {
+        channel_.enableWriting();
+    } else if (!flushQueued_) {
+        flushQueued_ = true;
+        loop_->queueFlush(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::setWriteCoalescing(bool on, bool useCork) {
+    loop_->assertInLoopThread();
+    coalesceWrites_ = on;
+    corkWrites_ = on && useCork;
+}
+
+void TcpConnection::flushInLoop() {
+    loop_->assertInLoopThread();
+    flushQueued_ = false;
+    if (state_ == StateE::kDisconnected || channel_.isWriting() || outputQueue_.empty()) {
+        return;
+    }
+    if (corkWrites_) {
+        socket_.setTcpCork(true);
+    }
+    int savedErrno = 0;
+    ssize_t n = 0;
+    bool wrote = false;
+    // 0 is a file region that was dropped, done with all the same
+    while (!outputQueue_.empty() &&
+           (n = outputQueue_.writeFd(channel_.fd(), &savedErrno)) >= 0) {
+        wrote = wrote || n > 0;
+    }
+    if (corkWrites_) {
+        socket_.setTcpCork(false);
+    }
+    if (wrote) {
+        lastActiveTime_ = loop_->pollReturnTime();
+    }
+    if (outputQueue_.empty()) {
+        outputDrained();
+    } else {
+        if (n < 0 && savedErrno != EWOULDBLOCK) {
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::flushInLoop";
+        }
+        // the rest, or the error, goes through handleWrite()
+        channel_.enableWriting();
+    }
+    updateBufferBytes();
+}
+
+void TcpConnection::outputDrained() {
+    if (channel_.isWriting()) {
+        channel_.disableWriting();
+    }
+    if (outputQueue_.buffer()->internalCapacity() > kIdleBufferCapacity) {
+        outputQueue_.buffer()->shrink(0);
+    }
+    if (writeCompleteCallback_) {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    // 执行writeCompleteCallback后可能关闭连接？
+    if (state_ == StateE::kDisconnecting) {
+        shutdownInLoop();
+    }
 }
 
 void TcpConnection::shutdown() {
@@ -160,8 +409,9 @@ void TcpConnection::shutdown() {
 
 void TcpConnection::shutdownInLoop() {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting()) {
-        socket_->shutdownWrite();
+    // coalesced output may wait for its flush with writing disabled
+    if (!channel_.isWriting() && outputQueue_.empty()) {
+        socket_.shutdownWrite();
     }
 }
 
@@ -204,7 +454,7 @@ const char* TcpConnection::stateToString() const {
 }
 
 void TcpConnection::setTcpNoDelay(bool on) {
-    socket_->setTcpNoDelay(on);
+    socket_.setTcpNoDelay(on);
 }
 
 void TcpConnection::startRead() {
@@ -213,20 +463,37 @@ void TcpConnection::startRead() {
 
 void TcpConnection::startReadInLoop() {
     loop_->assertInLoopThread();
-    if (!reading_ || !channel_->isReading()) {
-        channel_->enableReading();
+    if (!reading_ || !channel_.isReading()) {
+        channel_.enableReading();
         reading_ = true;
+        if (channel_.edgeTriggered()) {
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::resumeReadInLoop, shared_from_this()));
+        }
+    }
+}
+
+void TcpConnection::resumeReadInLoop() {
+    loop_->assertInLoopThread();
+    if (state_ != StateE::kDisconnected && channel_.isReading()) {
+        handleRead(Timestamp::now());
     }
 }
 
+void TcpConnection::setEdgeTriggered(bool on) {
+    loop_->assertInLoopThread();
+    assert(state_ == StateE::kConnecting);
+    channel_.setEdgeTriggered(on && loop_->supportsEdgeTriggered());
+}
+
 void TcpConnection::stopRead() {
     loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop() {
     loop_->assertInLoopThread();
-    if (reading_ || channel_->isReading()) {
-        channel_->disableReading();
+    if (reading_ || channel_.isReading()) {
+        channel_.disableReading();
         reading_ = false;
     }
 }
@@ -235,8 +502,9 @@ void TcpConnection::connectEstablished() {
     loop_->assertInLoopThread();
     assert(state_ == StateE::kConnecting);
     setState(StateE::kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading();
+    lastActiveTime_ = Timestamp::now();
+    channel_.tie(shared_from_this());
+    channel_.enableReading();
 
     connectionCallback_(shared_from_this());
 }
@@ -245,61 +513,123 @@ void TcpConnection::connectDestroyed() {
     loop_->assertInLoopThread();
     if (state_ == StateE::kConnected) {
         setState(StateE::kDisconnected);
-        channel_->disableAll();
+        channel_.disableAll();
         connectionCallback_(shared_from_this());
     }
-    channel_->remove();
+    channel_.remove();
+    loop_->addConnections(-1);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
     loop_->assertInLoopThread();
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    } else if (n == 0) {
-        handleClose();
-    } else {
-        errno = savedErrno;
-        LOG_SYSERR << "TcpConnection::handleRead";
-        handleError();
+    // edge-triggered, nothing is reported until more data arrives, so read
+    // until EAGAIN or EOF, a short read may have left the peer's FIN behind
+    const bool edgeTriggered = channel_.edgeTriggered();
+    for (int reads = 1;; ++reads) {
+        int savedErrno = 0;
+        inputBuffer_.ensureWritableBytes(readSize_);
+        size_t room = inputBuffer_.writableBytes();
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno);
+        if (n > 0) {
+            lastActiveTime_ = receiveTime;
+            size_t nread = static_cast<size_t>(n);
+            bool drained = nread < room;
+            adjustReadSize(nread);
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            // the socket had less than we made room for, likely quiet for a
+            // while, give the burst capacity back to the pool
+            if (drained && inputBuffer_.readableBytes() == 0 &&
+                inputBuffer_.internalCapacity() > kIdleBufferCapacity) {
+                inputBuffer_.shrink(0);
+            }
+            updateBufferBytes();
+            if (!edgeTriggered || state_ == StateE::kDisconnected ||
+                !channel_.isReading()) {
+                break;
+            }
+            if (reads == kMaxEdgeTriggeredReads) {
+                // let the other channels run, then go on
+                loop_->queueInLoop(
+                    std::bind(&TcpConnection::resumeReadInLoop, shared_from_this()));
+                break;
+            }
+        } else if (n == 0) {
+            handleClose();
+            break;
+        } else {
+            if (!(edgeTriggered && savedErrno == EAGAIN)) {
+                errno = savedErrno;
+                LOG_SYSERR << "TcpConnection::handleRead";
+                handleError();
+            }
+            break;
+        }
     }
 }
 
 void TcpConnection::handleWrite() {
     loop_->assertInLoopThread();
-    if (channel_->isWriting()) {
-        ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(),
-                                   outputBuffer_.readableBytes());
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                // 执行writeCompleteCallback后可能关闭连接？
-                if (state_ == StateE::kDisconnecting) {
-                    shutdownInLoop();
-                }
-            }
-        } else {
+    if (channel_.isWriting()) {
+        int savedErrno = 0;
+        // 0 is a file region that was dropped, done with all the same
+        ssize_t n = outputQueue_.writeFd(channel_.fd(), &savedErrno);
+        bool wrote = n > 0;
+        // edge-triggered, nothing is reported until the socket fills and
+        // drains again, so write until EAGAIN
+        while (n >= 0 && channel_.edgeTriggered() && !outputQueue_.empty()) {
+            n = outputQueue_.writeFd(channel_.fd(), &savedErrno);
+            wrote = wrote || n > 0;
+        }
+        if (wrote) {
+            lastActiveTime_ = loop_->pollReturnTime();
+        }
+        if (outputQueue_.empty()) {
+            outputDrained();
+        } else if (n < 0 && savedErrno != EWOULDBLOCK) {
+            errno = savedErrno;
             LOG_SYSERR << "TcpConnection::handleWrite";
         }
+        updateBufferBytes();
     } else {
-        LOG_TRACE << "Connection fd = " << channel_->fd()
+        LOG_TRACE << "Connection fd = " << channel_.fd()
                   << " is down, no more writing";
     }
 }
 
+void TcpConnection::adjustReadSize(size_t n) {
+    // grow at once when a read fills the room, shrink after two reads that
+    // take less than half of it
+    if (n >= readSize_) {
+        readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+        smallReads_ = 0;
+    } else if (n <= readSize_ / 2) {
+        if (++smallReads_ >= 2) {
+            readSize_ = std::max(readSize_ / 2, kMinReadSize);
+            smallReads_ = 0;
+        }
+    } else {
+        smallReads_ = 0;
+    }
+}
+
+void TcpConnection::updateBufferBytes() {
+    if (bufferBytesCounter_) {
+        int64_t bytes = static_cast<int64_t>(inputBuffer_.internalCapacity() +
+                                             outputQueue_.buffer()->internalCapacity());
+        if (bytes != reportedBufferBytes_) {
+            bufferBytesCounter_->add(bytes - reportedBufferBytes_);
+            reportedBufferBytes_ = bytes;
+        }
+    }
+}
+
 void TcpConnection::handleClose() {
     loop_->assertInLoopThread();
-    LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
+    LOG_TRACE << "fd = " << channel_.fd() << " state = " << stateToString();
     assert(state_ == StateE::kConnected || state_ == StateE::kDisconnecting);
 
     setState(StateE::kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr guardThis{shared_from_this()};
     connectionCallback_(guardThis);
@@ -307,7 +637,7 @@ void TcpConnection::handleClose() {
 }
 
 void TcpConnection::handleError() {
-    int err = sockets::getSocketError(channel_->fd());
-    LOG_ERROR << "TcpConnection::handleError [" << name_
+    int err = sockets::getSocketError(channel_.fd());
+    LOG_ERROR << "TcpConnection::handleError [" << name()
               << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
\ No newline at end of file
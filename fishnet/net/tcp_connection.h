@@ -2,7 +2,10 @@
 
 #include <boost/any.hpp>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "fishnet/base/atomic.h"
 #include "fishnet/base/noncopyable.h"
 #include "fishnet/base/string_piece.h"
 #include "fishnet/base/timestamp.h"
@@ -12,6 +15,7 @@
 #include "fishnet/net/channel.h"
 #include "fishnet/net/event_loop.h"
 #include "fishnet/net/inet_address.h"
+#include "fishnet/net/output_queue.h"
 #include "fishnet/net/socket.h"
 
 // struct tcp_info is in <netinet/tcp.h>
@@ -32,8 +36,15 @@ class Socket;
 class TcpConnection : noncopyable,
                       public std::enable_shared_from_this<TcpConnection> {
 public:
+    /// @param id numeric id, unique within its TcpServer or TcpClient
     TcpConnection(EventLoop* loop, const string& name, int sockfd,
-                  const InetAddress& localAddr, const InetAddress& peerAddr);
+                  const InetAddress& localAddr, const InetAddress& peerAddr,
+                  uint64_t id = 0);
+    /// Named namePrefix#id, the name is built the first time it's asked
+    /// for, so that connections nobody names cost no string.
+    TcpConnection(EventLoop* loop, const std::shared_ptr<const string>& namePrefix,
+                  int sockfd, const InetAddress& localAddr,
+                  const InetAddress& peerAddr, uint64_t id);
     ~TcpConnection();
 
     EventLoop* getLoop() const {
@@ -41,9 +52,16 @@ public:
     }
 
     const string& name() const {
+        if (namePrefix_) {
+            std::call_once(nameOnce_, &TcpConnection::buildName, this);
+        }
         return name_;
     }
 
+    uint64_t id() const {
+        return id_;
+    }
+
     const InetAddress& localAddress() const {
         return localAddr_;
     }
@@ -60,16 +78,47 @@ public:
         return state_ == StateE::kDisconnected;
     }
 
+    /// When data was last received or flushed from the output queue, or
+    /// when the connection was established. In loop thread.
+    Timestamp lastActiveTime() const {
+        return lastActiveTime_;
+    }
+
     bool getTcpInfo(struct tcp_info*) const;
 
     string getTcpInfoString() const;
 
-    // void send(string&& message); C++11
     void send(const void* message, int len);
     void send(const StringPiece& message);
+    void send(string&& message);
+    // steals the readable bytes of message when called from other threads
     void send(Buffer* message);
+    /// Queues the payload by reference, it is never copied.
+    void send(const SharedPayload& message);
+    /// Sends one payload to many connections, by reference like above.
+    /// Connections are grouped by loop, each other loop gets one functor for
+    /// all of its connections. Closed connections are skipped.
+    static void broadcast(const std::vector<TcpConnectionPtr>& conns,
+                          const SharedPayload& message);
+    /// Sends @c len bytes of file @c fd from @c offset with sendfile(2),
+    /// after everything sent before. @c fd is dup(2)ed, the caller may close
+    /// it right away but must not truncate the file.
+    void sendFile(int fd, off_t offset, size_t len);
     void shutdown();
 
+    /// Holds the output of sends in one loop iteration and writes it with
+    /// a single flush at the end of the iteration, instead of a write(2) per
+    /// send(). With @c useCork the flush runs under TCP_CORK, so only full
+    /// frames leave until it ends. Off by default.
+    /// In loop thread, e.g. in the connection callback.
+    void setWriteCoalescing(bool on, bool useCork = false);
+
+    /// Registers the socket edge-triggered, so that output filling and
+    /// draining costs no Poller update, reads and writes then go on until
+    /// EAGAIN. No-op if the poller of the loop doesn't support it.
+    /// In loop thread, before connectEstablished().
+    void setEdgeTriggered(bool on);
+
     void forceClose();
     void forceCloseWithDelay(double seconds);
     void setTcpNoDelay(bool on);
@@ -116,14 +165,29 @@ public:
         return &inputBuffer_;
     }
 
-    Buffer* outputBuffer() {
-        return &outputBuffer_;
+    /// Bytes copied into the output queue, large payloads queued by
+    /// reference are not in here. Read only, write with send().
+    const Buffer& outputBuffer() const {
+        return *outputQueue_.buffer();
+    }
+
+    /// All bytes waiting to be written.
+    size_t outputBytes() const {
+        return outputQueue_.readableBytes();
     }
 
     void setCloseCallback(const CloseCallback& cb) {
         closeCallback_ = cb;
     }
 
+    /// Keeps @c counter up to date with the capacity of the input and
+    /// output buffers, e.g. one counter for all connections of a TcpServer.
+    /// Call before connectEstablished().
+    void setBufferBytesCounter(const std::shared_ptr<AtomicInt64>& counter) {
+        bufferBytesCounter_ = counter;
+        updateBufferBytes();
+    }
+
     /// called when TcpServer accepts a new connection
     ///
     /// should be called only once
@@ -135,6 +199,13 @@ public:
     void connectDestroyed();
 
 private:
+    static const size_t kMinReadSize = Buffer::kInitialSize;
+    static const size_t kMaxReadSize = 64 * 1024;
+    // buffers above this are shrunk once empty
+    static const size_t kIdleBufferCapacity = Buffer::kCheapPrepend + Buffer::kInitialSize;
+    // edge-triggered reads per readiness event, before yielding to others
+    static const int kMaxEdgeTriggeredReads = 16;
+
     enum class StateE {
         kDisconnected,
         kConnecting,
@@ -148,21 +219,44 @@ private:
     void handleError();
     void sendInLoop(const StringPiece& message);
     void sendInLoop(const void* message, size_t len);
+    void sendInLoop(const void* message, size_t len, const std::shared_ptr<const void>& owner);
+    void sendPayloadInLoop(const SharedPayload& message);
+    static void broadcastInLoop(const std::shared_ptr<std::vector<TcpConnectionPtr>>& conns,
+                                const SharedPayload& message);
+    void sendBufferInLoop(const std::shared_ptr<Buffer>& message);
+    void sendFileInLoop(int fd, off_t offset, size_t len);
+    // after appending to outputQueue_
+    void startWriting();
+    void flushInLoop();
+    void outputDrained();
     void shutdownInLoop();
     void forceCloseInLoop();
+    TcpConnection(EventLoop* loop, const string& name,
+                  const std::shared_ptr<const string>& namePrefix, int sockfd,
+                  const InetAddress& localAddr, const InetAddress& peerAddr, uint64_t id);
+
+    void buildName() const;
     void setState(StateE s) {
         state_ = s;
     }
     const char* stateToString() const;
     void startReadInLoop();
+    // edge-triggered, reads what may have come while not reading
+    void resumeReadInLoop();
     void stopReadInLoop();
+    void adjustReadSize(size_t n);
+    void updateBufferBytes();
 
     EventLoop* loop_;
-    const string name_;
+    mutable string name_;
+    const std::shared_ptr<const string> namePrefix_;  // NULL if named up front
+    mutable std::once_flag nameOnce_;
+    const uint64_t id_;
     StateE state_;
     bool reading_;
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // held by value, one allocation per connection
+    Socket socket_;
+    Channel channel_;
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
     ConnectionCallback connectionCallback_;
@@ -171,9 +265,18 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
     size_t highWaterMark_;
+    bool coalesceWrites_;
+    bool corkWrites_;
+    bool flushQueued_;
     Buffer inputBuffer_;
-    Buffer outputBuffer_;
+    OutputQueue outputQueue_;
     boost::any context_;
+    Timestamp lastActiveTime_;
+    // bytes to make room for before each read, follows recent reads
+    size_t readSize_;
+    int smallReads_;
+    std::shared_ptr<AtomicInt64> bufferBytesCounter_;
+    int64_t reportedBufferBytes_;
 };
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
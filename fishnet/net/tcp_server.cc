@@ -1,13 +1,15 @@
 #include "fishnet/net/tcp_server.h"
 
-#include <cstdio>
-
+#include "fishnet/base/countdown_latch.h"
 #include "fishnet/base/logging.h"
+#include "fishnet/base/object_pool.h"
 #include "fishnet/net/acceptor.h"
 #include "fishnet/net/callbacks.h"
+#include "fishnet/net/connection_table.h"
 #include "fishnet/net/event_loop.h"
 #include "fishnet/net/event_loop_thread.h"
 #include "fishnet/net/event_loop_thread_pool.h"
+#include "fishnet/net/idle_reaper.h"
 #include "fishnet/net/inet_address.h"
 #include "fishnet/net/sockets_ops.h"
 #include "fishnet/net/tcp_connection.h"
@@ -15,29 +17,82 @@
 using namespace fishnet;
 using namespace fishnet::net;
 
+namespace {
+
+size_t hashOfIp(const InetAddress& addr) {
+    if (addr.family() == AF_INET) {
+        return std::hash<uint32_t>()(addr.ipv4NetEndian());
+    }
+    // FNV-1a over the IPv6 address
+    const struct sockaddr_in6* addr6 =
+        sockets::sockaddr_in6_cast(addr.getSockAddr());
+    const unsigned char* bytes = addr6->sin6_addr.s6_addr;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(addr6->sin6_addr); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+}  // namespace
+
+struct TcpServer::IoLoopState {
+    IoLoopState(EventLoop* ioLoop, int shard) : loop(ioLoop), connections(shard) {}
+
+    EventLoop* loop;
+    // kReusePortPerLoop only
+    std::unique_ptr<Acceptor> acceptor;
+    ConnectionTable connections;  // of this loop
+    // NULL without idle timeout, looks up connections, so declared after
+    std::shared_ptr<IdleReaper> idleReaper;
+};
+
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr,
                      const string& nameArg, Option option)
     : loop_(CHECK_NOTNULL(loop)),
+      listenAddr_(listenAddr),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
-      acceptor_(new Acceptor{loop, listenAddr, option == Option::kReusePort}),
+      connNamePrefix_(std::make_shared<const string>(nameArg + "-" + ipPort_)),
+      acceptPerLoop_(option == Option::kReusePortPerLoop),
       threadPool_(new EventLoopThreadPool{loop, name_}),
       connectionCallback_(defaultConnectionCallback),
       messageCallback_(defaultMessageCallback),
-      nextConnId_(1) {
-    acceptor_->setNewConnectionCallback(
-        std::bind(&TcpServer::newConnection, this, _1, _2));
+      idleTimeout_(0.0),
+      maxAcceptsPerTick_(Acceptor::kDefaultMaxAcceptsPerTick),
+      loopSelection_(LoopSelection::kRoundRobin),
+      writeCoalescing_(false),
+      writeCork_(false),
+      edgeTriggered_(false),
+      bufferBytes_(std::make_shared<AtomicInt64>()),
+      alive_(std::make_shared<bool>(true)) {
+    if (!acceptPerLoop_) {
+        acceptor_.reset(
+            new Acceptor{loop, listenAddr, option == Option::kReusePort});
+        acceptor_->setNewConnectionCallback(
+            std::bind(&TcpServer::newConnection, this, _1, _2));
+    }
 }
 
 TcpServer::~TcpServer() {
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+    // accepts still queued to I/O loops close their sockets from now on
+    alive_.reset();
 
-    for (auto& item : connections_) {
-        TcpConnectionPtr conn{item.second};
-        item.second.reset();
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn));
+    for (auto& item : ioLoops_) {
+        if (item.second->idleReaper) {
+            item.second->idleReaper->stop();
+        }
+        // connections, and acceptors of kReusePortPerLoop, live in their
+        // loops, wait for them to go so that no callback sees a dead server
+        CountDownLatch latch{1};
+        EventLoop* ioLoop = item.first;
+        ioLoop->runInLoop([this, ioLoop, &latch] {
+            destroyIoLoopState(ioLoop);
+            latch.countDown();
+        });
+        latch.wait();
     }
 }
 
@@ -46,49 +101,239 @@ void TcpServer::setThreadNum(int numThreads) {
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setCpuAffinity(const std::vector<int>& cpus) {
+    threadPool_->setCpuAffinity(cpus);
+}
+
 void TcpServer::start() {
     if (started_.getAndAdd(1) == 0) {
         threadPool_->start(threadInitCallback_);
 
-        assert(!acceptor_->listening());
-        loop_->runInLoop(std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        if (loops.size() > ConnectionTable::kMaxShards) {
+            LOG_FATAL << "TcpServer::start [" << name_ << "] - more than "
+                      << ConnectionTable::kMaxShards << " I/O loops";
+        }
+        for (EventLoop* ioLoop : loops) {
+            std::unique_ptr<IoLoopState> state{
+                new IoLoopState{ioLoop, static_cast<int>(shards_.size())}};
+            shards_.push_back(get_pointer(state));
+            if (idleTimeout_ > 0.0) {
+                state->idleReaper.reset(
+                    new IdleReaper{ioLoop, &state->connections, idleTimeout_});
+                state->idleReaper->start();
+            }
+            if (acceptPerLoop_) {
+                state->acceptor.reset(new Acceptor{ioLoop, listenAddr_, true});
+                state->acceptor->setMaxAcceptsPerTick(maxAcceptsPerTick_);
+                if (loopSelection_ == LoopSelection::kIncomingCpu) {
+                    int cpu = threadPool_->getCpuOfLoop(ioLoop);
+                    if (cpu >= 0) {
+                        state->acceptor->setIncomingCpu(cpu);
+                    }
+                }
+                state->acceptor->setNewConnectionCallback(std::bind(
+                    &TcpServer::newConnectionInIoLoop, this, ioLoop, _1, _2));
+            }
+            ioLoops_[ioLoop] = std::move(state);
+        }
+
+        if (acceptPerLoop_) {
+            for (auto& item : ioLoops_) {
+                item.first->runInLoop(std::bind(
+                    &Acceptor::listen, get_pointer(item.second->acceptor)));
+            }
+        } else {
+            assert(!acceptor_->listening());
+            acceptor_->setMaxAcceptsPerTick(maxAcceptsPerTick_);
+            loop_->runInLoop(
+                std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+        }
     }
 }
 
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
-    loop_->assertInLoopThread();
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    char buf[64];
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    string connName = name_ + buf;
-
-    LOG_INFO << "TcpServer::newConnection [" << name_ << "] - new connection ["
-             << connName << "] from " << peerAddr.toIpPort();
+TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop, int sockfd,
+                                             const InetAddress& peerAddr,
+                                             uint64_t id) {
     InetAddress localAddr{sockets::getLocalAddr(sockfd)};
 
-    TcpConnectionPtr conn{
-        new TcpConnection{ioLoop, connName, sockfd, localAddr, peerAddr}};
-    connections_[connName] = conn;
+    // the connection and its control block in one block, recycled by the
+    // pool of this loop. Its name is built only if asked for.
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(), ioLoop, connNamePrefix_, sockfd, localAddr,
+        peerAddr, id);
+    LOG_INFO << "TcpServer::newConnection [" << name_ << "] - new connection #"
+             << conn->id() << " from " << peerAddr.toIpPort();
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, _1));  // FIXME: unsafe
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    conn->setBufferBytesCounter(bufferBytes_);
+    if (writeCoalescing_) {
+        conn->setWriteCoalescing(true, writeCork_);
+    }
+    if (edgeTriggered_) {
+        conn->setEdgeTriggered(true);
+    }
+    return conn;
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+EventLoop* TcpServer::selectLoop(int sockfd, const InetAddress& peerAddr) {
+    switch (loopSelection_) {
+        case LoopSelection::kIncomingCpu: {
+            EventLoop* ioLoop = threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd));
+            return ioLoop != NULL ? ioLoop : threadPool_->getNextLoop();
+        }
+        case LoopSelection::kLeastConnections:
+            return threadPool_->getLeastConnectionsLoop();
+        case LoopSelection::kLeastQueued:
+            return threadPool_->getLeastQueuedLoop();
+        case LoopSelection::kPeerAddressHash:
+            return threadPool_->getLoopForHash(hashOfIp(peerAddr));
+        case LoopSelection::kRoundRobin:
+        default:
+            return threadPool_->getNextLoop();
+    }
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
+void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
     loop_->assertInLoopThread();
-    LOG_INFO << "TcpServer::removeConnectionLoop [" << name_
-             << "] - connection " << conn->name();
-    size_t n = connections_.erase(conn->name());
-    (void)n;
-    assert(n == 1);
+    EventLoop* ioLoop = selectLoop(sockfd, peerAddr);
+    // built in its own loop, so that its memory comes from and goes back to
+    // the pools of that thread. Counted for the loop until the connection
+    // counts itself, so that loop selection sees a burst of new connections.
+    ioLoop->addConnections(1);
+    // the server may be destroyed before the functor runs. Once it sees
+    // alive_ it's safe, ~TcpServer() waits for the loop after resetting it.
+    std::weak_ptr<bool> alive(alive_);
+    ioLoop->runInLoop([this, alive, ioLoop, sockfd, peerAddr] {
+        ioLoop->addConnections(-1);
+        if (alive.expired()) {
+            sockets::close(sockfd);
+            return;
+        }
+        newConnectionInIoLoop(ioLoop, sockfd, peerAddr);
+    });
+}
+
+void TcpServer::newConnectionInIoLoop(EventLoop* ioLoop, int sockfd,
+                                      const InetAddress& peerAddr) {
+    ioLoop->assertInLoopThread();
+    IoLoopState& state = *ioLoops_.find(ioLoop)->second;
+    uint64_t id = state.connections.acquire();
+    TcpConnectionPtr conn = createConnection(ioLoop, sockfd, peerAddr, id);
+    state.connections.set(id, conn);
+    conn->setCloseCallback(
+        std::bind(&TcpServer::removeConnectionInIoLoop, this, _1));
+    conn->connectEstablished();
+    if (state.idleReaper) {
+        state.idleReaper->add(conn);
+    }
+}
+
+void TcpServer::pauseAccepting() {
+    if (acceptor_) {
+        loop_->runInLoop(std::bind(&Acceptor::pause, get_pointer(acceptor_)));
+    }
+    for (auto& item : ioLoops_) {
+        if (item.second->acceptor) {
+            item.first->runInLoop(
+                std::bind(&Acceptor::pause, get_pointer(item.second->acceptor)));
+        }
+    }
+}
+
+void TcpServer::resumeAccepting() {
+    if (acceptor_) {
+        loop_->runInLoop(std::bind(&Acceptor::resume, get_pointer(acceptor_)));
+    }
+    for (auto& item : ioLoops_) {
+        if (item.second->acceptor) {
+            item.first->runInLoop(
+                std::bind(&Acceptor::resume, get_pointer(item.second->acceptor)));
+        }
+    }
+}
+
+TcpConnectionPtr TcpServer::findConnection(uint64_t id) const {
+    size_t shard = static_cast<size_t>(ConnectionTable::shardOf(id));
+    if (shard >= shards_.size()) {
+        return TcpConnectionPtr();
+    }
+    return shards_[shard]->connections.find(id);
+}
+
+bool TcpServer::send(uint64_t id, const StringPiece& message) {
+    TcpConnectionPtr conn = findConnection(id);
+    if (!conn) {
+        return false;
+    }
+    conn->send(message);
+    return true;
+}
+
+void TcpServer::broadcast(const std::vector<uint64_t>& ids, const SharedPayload& message) {
+    std::vector<std::shared_ptr<std::vector<uint64_t>>> byShard(shards_.size());
+    for (uint64_t id : ids) {
+        size_t shard = static_cast<size_t>(ConnectionTable::shardOf(id));
+        if (shard < byShard.size()) {
+            if (!byShard[shard]) {
+                byShard[shard] = std::make_shared<std::vector<uint64_t>>();
+            }
+            byShard[shard]->push_back(id);
+        }
+    }
+    for (size_t shard = 0; shard < byShard.size(); ++shard) {
+        if (byShard[shard]) {
+            shards_[shard]->loop->runInLoop(std::bind(&TcpServer::broadcastInLoop, this,
+                                                      shard, byShard[shard], message));
+        }
+    }
+}
+
+void TcpServer::broadcastInLoop(size_t shard, const std::shared_ptr<std::vector<uint64_t>>& ids,
+                                const SharedPayload& message) {
+    const ConnectionTable& connections = shards_[shard]->connections;
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(ids->size());
+    for (uint64_t id : *ids) {
+        TcpConnectionPtr conn = connections.find(id);
+        if (conn) {
+            conns.push_back(std::move(conn));
+        }
+    }
+    // all in this loop, sent right away
+    TcpConnection::broadcast(conns, message);
+}
+
+int64_t TcpServer::numIdleReaped() const {
+    int64_t n = 0;
+    for (const auto& item : ioLoops_) {
+        if (item.second->idleReaper) {
+            n += item.second->idleReaper->numReaped();
+        }
+    }
+    return n;
+}
+
+void TcpServer::removeConnectionInIoLoop(const TcpConnectionPtr& conn) {
     EventLoop* ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    LOG_INFO << "TcpServer::removeConnectionInIoLoop [" << name_ << "] - connection #"
+             << conn->id() << " from " << conn->peerAddress().toIpPort();
+    bool removed = ioLoops_.find(ioLoop)->second->connections.release(conn->id());
+    (void)removed;
+    assert(removed);
+    // still in Channel::handleEvent, destroy it later
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
+
+void TcpServer::destroyIoLoopState(EventLoop* ioLoop) {
+    ioLoop->assertInLoopThread();
+    IoLoopState& state = *ioLoops_.find(ioLoop)->second;
+    state.acceptor.reset();
+    std::vector<TcpConnectionPtr> conns;
+    state.connections.takeAll(&conns);
+    for (const TcpConnectionPtr& conn : conns) {
+        conn->connectDestroyed();
+    }
+}
@@ -2,9 +2,11 @@
 
 #include <functional>
 #include <map>
+#include <vector>
 
 #include "fishnet/base/atomic.h"
 #include "fishnet/base/noncopyable.h"
+#include "fishnet/base/string_piece.h"
 #include "fishnet/base/types.h"
 #include "fishnet/net/acceptor.h"
 #include "fishnet/net/callbacks.h"
@@ -19,12 +21,37 @@ namespace net {
 class Acceptor;
 class EventLoop;
 class EventLoopThreadPool;
+class IdleReaper;
 
 class TcpServer : noncopyable {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
-    enum class Option { kNoReusePort, kReusePort };
+    ///
+    /// kReusePortPerLoop gives each I/O loop its own SO_REUSEPORT acceptor,
+    /// the kernel spreads new connections over them and every loop accepts
+    /// and keeps its connections locally, the base loop is out of the way.
+    ///
+    enum class Option { kNoReusePort, kReusePort, kReusePortPerLoop };
+
+    ///
+    /// How a new connection picks its I/O loop.
+    /// - kRoundRobin, the default.
+    /// - kLeastConnections, the loop with the fewest connections.
+    /// - kLeastQueued, the loop with the fewest pending functors.
+    /// - kPeerAddressHash, consistent hashing of the peer IP, connections of
+    ///   the same client share a loop.
+    /// - kIncomingCpu, the loop pinned to the CPU that received the
+    ///   connection (SO_INCOMING_CPU), see setCpuAffinity(). Round-robin
+    ///   when no loop is pinned there.
+    ///
+    enum class LoopSelection {
+        kRoundRobin,
+        kLeastConnections,
+        kLeastQueued,
+        kPeerAddressHash,
+        kIncomingCpu
+    };
 
     TcpServer(EventLoop* loop, const InetAddress& listenAddr,
               const string& nameArg, Option option = Option::kNoReusePort);
@@ -45,16 +72,89 @@ public:
 
     /// Set the number of threads for handling input.
     ///
-    /// Always accepts new connection in loop's thread.
+    /// Accepts new connection in loop's thread, unless
+    /// Option::kReusePortPerLoop is given.
     /// Must be called before @c start
     /// @param numThreads
     /// - 0 means all I/O in loop's thread, no thread will created.
     ///   this is the default value.
     /// - 1 means all I/O in another thread.
     /// - N means a thread pool with N threads, new connections
-    ///   are assigned on a round-robin basis.
+    ///   are assigned as setLoopSelection() says.
     void setThreadNum(int numThreads);
 
+    /// Ignored with Option::kReusePortPerLoop, where the kernel picks,
+    /// except kIncomingCpu: the listening socket of each pinned loop is
+    /// then tagged with its CPU, for the kernel to prefer it.
+    /// Must be called before @c start
+    void setLoopSelection(LoopSelection selection) {
+        loopSelection_ = selection;
+    }
+
+    /// EventLoopThreadPool::setCpuAffinity() of the I/O loops.
+    /// Must be called before @c start
+    void setCpuAffinity(const std::vector<int>& cpus);
+
+    /// Force closes connections without any traffic for @c seconds,
+    /// checked by a bucketed reaper in each I/O loop.
+    /// 0 disables it, the default.
+    /// Must be called before @c start
+    void setIdleTimeout(double seconds) {
+        idleTimeout_ = seconds;
+    }
+
+    /// Caps the connections accepted per readiness event of the listening
+    /// socket, so that a connection storm can't starve the I/O of a loop.
+    /// Must be called before @c start
+    void setMaxAcceptsPerTick(int n) {
+        maxAcceptsPerTick_ = n;
+    }
+
+    /// TcpConnection::setWriteCoalescing() for every connection.
+    /// Must be called before @c start
+    void setWriteCoalescing(bool on, bool useCork = false) {
+        writeCoalescing_ = on;
+        writeCork_ = useCork;
+    }
+
+    /// TcpConnection::setEdgeTriggered() for every connection.
+    /// Must be called before @c start
+    void setEdgeTriggered(bool on) {
+        edgeTriggered_ = on;
+    }
+
+    /// Stops accepting, new connections wait in the listen queue.
+    /// Thread safe.
+    void pauseAccepting();
+
+    /// Thread safe.
+    void resumeAccepting();
+
+    /// Capacity of the input and output buffers of all connections.
+    /// Thread safe.
+    int64_t bufferBytes() const {
+        return bufferBytes_->get();
+    }
+
+    /// The connection of TcpConnection::id(), NULL if it's gone.
+    /// Thread safe, valid after calling start()
+    TcpConnectionPtr findConnection(uint64_t id) const;
+
+    /// Sends to the connection of TcpConnection::id(), returns false if it's
+    /// gone.
+    /// Thread safe, valid after calling start()
+    bool send(uint64_t id, const StringPiece& message);
+
+    /// Sends one payload to the connections of ids without copying it,
+    /// each I/O loop gets one functor for all of its connections. Ids of
+    /// gone connections are skipped.
+    /// Thread safe, valid after calling start()
+    void broadcast(const std::vector<uint64_t>& ids, const SharedPayload& message);
+
+    /// Connections closed for being idle so far.
+    /// Thread safe, valid after calling start()
+    int64_t numIdleReaped() const;
+
     void setThreadInitCallback(const ThreadInitCallback& cb) {
         threadInitCallback_ = cb;
     }
@@ -92,27 +192,53 @@ private:
     /// Not thread safe, but in loop
     void newConnection(int sockfd, const InetAddress& peerAddr);
 
-    /// Not thread safe, but in loop
-    void removeConnection(const TcpConnectionPtr& conn);
+    /// Not thread safe, but in ioLoop
+    void newConnectionInIoLoop(EventLoop* ioLoop, int sockfd,
+                               const InetAddress& peerAddr);
 
-    /// Not thread safe, but in loop
-    void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    /// Not thread safe, but in ioLoop
+    void removeConnectionInIoLoop(const TcpConnectionPtr& conn);
+
+    EventLoop* selectLoop(int sockfd, const InetAddress& peerAddr);
+
+    TcpConnectionPtr createConnection(EventLoop* ioLoop, int sockfd,
+                                      const InetAddress& peerAddr, uint64_t id);
+
+    void destroyIoLoopState(EventLoop* ioLoop);
+
+    /// in the loop of shard
+    void broadcastInLoop(size_t shard, const std::shared_ptr<std::vector<uint64_t>>& ids,
+                         const SharedPayload& message);
 
-    using ConnectionMap = std::map<string, TcpConnectionPtr>;
+    struct IoLoopState;
+    using IoLoopMap = std::map<EventLoop*, std::unique_ptr<IoLoopState>>;
 
     EventLoop* loop_;  // the acceptor loop
+    const InetAddress listenAddr_;
     const string ipPort_;
     const string name_;
-    std::unique_ptr<Acceptor> acceptor_;  // avoid revealing Acceptor
+    // of the connection names, name-ip:port, see TcpConnection::name()
+    const std::shared_ptr<const string> connNamePrefix_;
+    const bool acceptPerLoop_;
+    std::unique_ptr<Acceptor> acceptor_;  // avoid revealing Acceptor, NULL if acceptPerLoop_
     std::shared_ptr<EventLoopThreadPool> threadPool_;
     ConnectionCallback connectionCallback_;
     MessageCallback messageCallback_;
     WriteCompleteCallback writeCompleteCallback_;
     ThreadInitCallback threadInitCallback_;
     AtomicInt32 started_;
-    // always in loop thread
-    int nextConnId_;
-    ConnectionMap connections_;
+    double idleTimeout_;
+    int maxAcceptsPerTick_;
+    LoopSelection loopSelection_;
+    bool writeCoalescing_;
+    bool writeCork_;
+    bool edgeTriggered_;
+    std::shared_ptr<AtomicInt64> bufferBytes_;
+    // one per I/O loop, fixed after start()
+    IoLoopMap ioLoops_;
+    std::vector<IoLoopState*> shards_;  // by ConnectionTable shard
+    // held weakly by what is queued to I/O loops, reset first in ~TcpServer()
+    std::shared_ptr<bool> alive_;
 };
 
 }  // namespace net
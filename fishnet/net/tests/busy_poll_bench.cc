@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "fishnet/base/countdown_latch.h"
+#include "fishnet/base/logging.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/buffer.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/event_loop_thread.h"
+#include "fishnet/net/inet_address.h"
+#include "fishnet/net/tcp_client.h"
+#include "fishnet/net/tcp_connection.h"
+#include "fishnet/net/tcp_server.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+// Round trip latency of small pingpong messages between two loops, blocking
+// in epoll_wait vs spinning before sleep, and of a queueInLoop() hop.
+//
+// usage: busy_poll_bench [busy_poll_us [server_cpu client_cpu]]
+// Spinning needs a CPU per loop, pin them to distinct cores.
+
+namespace {
+
+const uint16_t kPort = 2018;
+const int kRounds = 20000;
+const size_t kMessageSize = 64;
+
+void printPercentiles(const char* what, std::vector<int64_t>* micros) {
+    std::sort(micros->begin(), micros->end());
+    size_t n = micros->size();
+    printf("  %-9s p50 %5" PRId64 " us  p99 %5" PRId64 " us  p999 %5" PRId64
+           " us  max %6" PRId64 " us\n",
+           what, (*micros)[n / 2], (*micros)[n * 99 / 100], (*micros)[n * 999 / 1000],
+           micros->back());
+}
+
+class Pingpong : noncopyable {
+public:
+    Pingpong(EventLoop* loop, const InetAddress& serverAddr, CountDownLatch* done)
+        : client_(loop, serverAddr, "BusyPollBench"), message_(kMessageSize, 'x'), done_(done) {
+        rtts_.reserve(kRounds);
+        client_.setConnectionCallback(std::bind(&Pingpong::onConnection, this, _1));
+        client_.setMessageCallback(std::bind(&Pingpong::onMessage, this, _1, _2, _3));
+        client_.connect();
+    }
+
+    std::vector<int64_t>* rtts() {
+        return &rtts_;
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setTcpNoDelay(true);
+            ping(conn);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        if (buf->readableBytes() < kMessageSize) {
+            return;
+        }
+        buf->retrieve(kMessageSize);
+        rtts_.push_back(Timestamp::now().microSecondsSinceEpoch() -
+                        sent_.microSecondsSinceEpoch());
+        if (rtts_.size() < static_cast<size_t>(kRounds)) {
+            ping(conn);
+        } else {
+            conn->shutdown();
+            done_->countDown();
+        }
+    }
+
+    void ping(const TcpConnectionPtr& conn) {
+        sent_ = Timestamp::now();
+        conn->send(StringPiece(message_));
+    }
+
+    TcpClient client_;
+    string message_;
+    CountDownLatch* done_;
+    Timestamp sent_;
+    std::vector<int64_t> rtts_;
+};
+
+void bench(int64_t busyPollMicros, int serverCpu, int clientCpu) {
+    EventLoopThread serverThread;
+    EventLoopThread clientThread;
+    serverThread.setBusyPollMicros(busyPollMicros);
+    clientThread.setBusyPollMicros(busyPollMicros);
+    serverThread.setCpuAffinity(serverCpu);
+    clientThread.setCpuAffinity(clientCpu);
+    EventLoop* serverLoop = serverThread.startLoop();
+    EventLoop* clientLoop = clientThread.startLoop();
+
+    std::unique_ptr<TcpServer> server;
+    std::unique_ptr<Pingpong> pingpong;
+    CountDownLatch done{1};
+    CountDownLatch ready{1};
+    serverLoop->runInLoop([&] {
+        server.reset(new TcpServer{serverLoop, InetAddress{kPort, true}, "BusyPollBench",
+                                   TcpServer::Option::kReusePort});
+        server->setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected()) {
+                conn->setTcpNoDelay(true);
+            }
+        });
+        server->setMessageCallback(
+            [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+        server->start();
+        ready.countDown();
+    });
+    ready.wait();
+    clientLoop->runInLoop(
+        [&] { pingpong.reset(new Pingpong{clientLoop, InetAddress{kPort, true}, &done}); });
+    done.wait();
+
+    // a functor posted from this thread, queued to run
+    std::vector<int64_t> hops;
+    hops.reserve(kRounds);
+    for (int i = 0; i < kRounds; ++i) {
+        CountDownLatch ran{1};
+        Timestamp posted{Timestamp::now()};
+        int64_t hop = 0;
+        serverLoop->queueInLoop([&] {
+            hop = Timestamp::now().microSecondsSinceEpoch() - posted.microSecondsSinceEpoch();
+            ran.countDown();
+        });
+        ran.wait();
+        hops.push_back(hop);
+    }
+
+    printf("busy poll %" PRId64 " us, %" PRId64 " spinning polls\n", busyPollMicros,
+           serverLoop->metrics().snapshot().busyPolls +
+               clientLoop->metrics().snapshot().busyPolls);
+    printPercentiles("pingpong", pingpong->rtts());
+    printPercentiles("functor", &hops);
+
+    CountDownLatch destroyed{2};
+    clientLoop->runInLoop([&] {
+        pingpong.reset();
+        destroyed.countDown();
+    });
+    serverLoop->runInLoop([&] {
+        server.reset();
+        destroyed.countDown();
+    });
+    destroyed.wait();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Logger::setLogLevel(Logger::LogLevel::WARN);
+    int64_t busyPollMicros = argc > 1 ? atoll(argv[1]) : 50;
+    int serverCpu = argc > 3 ? atoi(argv[2]) : -1;
+    int clientCpu = argc > 3 ? atoi(argv[3]) : -1;
+    bench(0, serverCpu, clientCpu);
+    bench(busyPollMicros, serverCpu, clientCpu);
+}
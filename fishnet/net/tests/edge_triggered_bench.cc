@@ -0,0 +1,117 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fishnet/base/logging.h"
+#include "fishnet/base/thread.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/buffer.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/inet_address.h"
+#include "fishnet/net/tcp_connection.h"
+#include "fishnet/net/tcp_server.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+// Echo of large messages, level-triggered vs edge-triggered: Poller updates
+// (epoll_ctl calls) per message as the output buffer fills and drains.
+
+namespace {
+
+const uint16_t kPort = 2017;
+const int kSessions = 8;
+const int kRounds = 16;
+const size_t kMessageSize = 16 * 1024 * 1024;
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// blocking client, writes a whole message then reads the echo back
+void runSession(const InetAddress& serverAddr) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    // a small window, so that the output buffer of the server fills
+    int rcvbuf = 64 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (::connect(fd, serverAddr.getSockAddr(), sizeof(struct sockaddr_in)) < 0) {
+        LOG_SYSFATAL << "connect";
+    }
+    std::string message(kMessageSize, 'x');
+    std::string echo(kMessageSize, '\0');
+    for (int i = 0; i < kRounds; ++i) {
+        if (!writeAll(fd, message.data(), message.size()) ||
+            !readAll(fd, &*echo.begin(), echo.size())) {
+            LOG_FATAL << "session broken";
+        }
+    }
+    ::close(fd);
+}
+
+void bench(bool edgeTriggered) {
+    EventLoop loop;
+    InetAddress listenAddr{kPort, true};
+    TcpServer server{&loop, listenAddr, "EdgeTriggeredBench", TcpServer::Option::kReusePort};
+    server.setEdgeTriggered(edgeTriggered);
+    server.setMessageCallback(
+        [](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->send(buf); });
+    server.start();
+
+    double seconds = 0;
+    Thread clients([&loop, &listenAddr, &seconds] {
+        std::vector<std::unique_ptr<Thread>> sessions;
+        Timestamp begin(Timestamp::now());
+        for (int i = 0; i < kSessions; ++i) {
+            sessions.emplace_back(new Thread(std::bind(runSession, listenAddr)));
+            sessions.back()->start();
+        }
+        for (auto& t : sessions) {
+            t->join();
+        }
+        seconds = timeDifference(Timestamp::now(), begin);
+        loop.quit();
+    });
+    clients.start();
+    loop.loop();
+    clients.join();
+
+    const double messages = static_cast<double>(kSessions) * kRounds;
+    const int64_t updates = loop.metrics().snapshot().channelUpdates;
+    printf("%s: %8" PRId64 " epoll_ctl, %6.2f per message, %8.1f MiB/s\n",
+           edgeTriggered ? "edge-triggered " : "level-triggered", updates,
+           static_cast<double>(updates) / messages,
+           messages * kMessageSize / seconds / 1024 / 1024);
+}
+
+}  // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::LogLevel::WARN);
+    bench(false);
+    bench(true);
+}
@@ -0,0 +1,65 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "fishnet/base/countdown_latch.h"
+#include "fishnet/base/logging.h"
+#include "fishnet/base/thread.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/event_loop.h"
+#include "fishnet/net/event_loop_thread.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+// Fan-in of many producer threads into one EventLoop through queueInLoop().
+
+namespace {
+
+const int kFunctorsPerRun = 2000000;
+
+int64_t g_counter = 0;  // only touched in the loop thread
+
+void bench(EventLoop* loop, int numProducers) {
+    const int perProducer = kFunctorsPerRun / numProducers;
+    const int64_t total = static_cast<int64_t>(perProducer) * numProducers;
+    g_counter = 0;
+    CountDownLatch start(1);
+    CountDownLatch done(1);
+
+    std::vector<std::unique_ptr<Thread>> producers;
+    for (int i = 0; i < numProducers; ++i) {
+        producers.emplace_back(new Thread([loop, perProducer, total, &start, &done] {
+            start.wait();
+            for (int j = 0; j < perProducer; ++j) {
+                loop->queueInLoop([total, &done] {
+                    if (++g_counter == total) {
+                        done.countDown();
+                    }
+                });
+            }
+        }));
+        producers.back()->start();
+    }
+
+    Timestamp begin(Timestamp::now());
+    start.countDown();
+    done.wait();
+    double seconds = timeDifference(Timestamp::now(), begin);
+    for (auto& t : producers) {
+        t->join();
+    }
+    printf("%2d producers: %10.0f functors/s\n", numProducers,
+           static_cast<double>(total) / seconds);
+}
+
+}  // namespace
+
+int main() {
+    Logger::setLogLevel(Logger::LogLevel::WARN);
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+    for (int n = 1; n <= 64; n *= 2) {
+        bench(loop, n);
+    }
+}
\ No newline at end of file
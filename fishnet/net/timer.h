@@ -18,7 +18,19 @@ public:
           expiration_(when),
           interval_(interval),
           repeat_(interval > 0.0),
-          sequence_(s_numCreated_.incrementAndGet()) {}
+          sequence_(s_numCreated_.incrementAndGet()),
+          prev_(NULL),
+          next_(NULL),
+          list_(NULL) {}
+
+    /// Recycles a finished timer as a new one, with a new sequence.
+    void reuse(TimerCallback cb, Timestamp when, double interval) {
+        callback_ = std::move(cb);
+        expiration_ = when;
+        interval_ = interval;
+        repeat_ = interval > 0.0;
+        sequence_ = s_numCreated_.incrementAndGet();
+    }
 
     void run() const {
         callback_();
@@ -38,16 +50,32 @@ public:
 
     void restart(Timestamp now);
 
+    void setExpiration(Timestamp when) {
+        expiration_ = when;
+    }
+
+    /// Drops the callback, and whatever it captured, of a finished timer.
+    void clear() {
+        callback_ = TimerCallback();
+    }
+
     static int64_t numCreated() {
         return s_numCreated_.get();
     }
 
 private:
-    const TimerCallback callback_;
+    friend class TimingWheel;
+
+    TimerCallback callback_;
     Timestamp expiration_;
-    const double interval_;
-    const bool repeat_;
-    const int64_t sequence_;
+    double interval_;
+    bool repeat_;
+    int64_t sequence_;
+
+    // intrusive list node, used by TimingWheel only
+    Timer* prev_;
+    Timer* next_;
+    Timer** list_;  // head of the list it's linked in, NULL if unlinked
 
     static AtomicInt64 s_numCreated_;
 };
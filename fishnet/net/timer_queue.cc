@@ -10,11 +10,14 @@
 #include <sys/timerfd.h>
 #include <unistd.h>
 
+#include <cstdlib>
+
 #include "fishnet/base/logging.h"
 #include "fishnet/net/event_loop.h"
 #include "fishnet/net/timer.h"
 #include "fishnet/net/timer_id.h"
 #include "fishnet/net/timer_queue.h"
+#include "fishnet/net/timing_wheel.h"
 
 namespace fishnet {
 
@@ -82,6 +85,9 @@ TimerQueue::TimerQueue(EventLoop* loop)
       timerfdChannel_(loop, timerfd_),
       timers_(),
       callingExpiredTimers_(false) {
+    if (::getenv("FISHNET_USE_TIMING_WHEEL")) {
+        wheel_.reset(new TimingWheel);
+    }
     timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
     timerfdChannel_.enableReading();
 }
@@ -98,6 +104,12 @@ TimerQueue::~TimerQueue() {
 
 TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when,
                              double interval) {
+    if (wheel_ && loop_->isInLoopThread()) {
+        // the free list of the wheel is not thread safe
+        Timer* timer = wheel_->newTimer(std::move(cb), when, interval);
+        addTimerInLoop(timer);
+        return TimerId(timer, timer->sequence());
+    }
     Timer* timer = new Timer(std::move(cb), when, interval);
     loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
     return TimerId(timer, timer->sequence());
@@ -107,8 +119,18 @@ void TimerQueue::cancel(TimerId timerId) {
     loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
 }
 
+void TimerQueue::restart(TimerId timerId, Timestamp when) {
+    loop_->runInLoop(
+        std::bind(&TimerQueue::restartInLoop, this, timerId, when));
+}
+
 void TimerQueue::addTimerInLoop(Timer* timer) {
     loop_->assertInLoopThread();
+    if (wheel_) {
+        wheel_->add(timer);
+        resetWheelTimerfd(timer->expiration());
+        return;
+    }
     bool earliestChanged = insert(timer);
 
     if (earliestChanged) {
@@ -118,6 +140,11 @@ void TimerQueue::addTimerInLoop(Timer* timer) {
 
 void TimerQueue::cancelInLoop(TimerId timerId) {
     loop_->assertInLoopThread();
+    if (wheel_) {
+        // a stale timerfd alarm is harmless, leave it armed
+        wheel_->cancel(timerId.timer_, timerId.sequence_);
+        return;
+    }
     assert(timers_.size() == activeTimers_.size());
     ActiveTimer timer{timerId.timer_, timerId.sequence_};
     ActiveTimerSet::iterator it = activeTimers_.find(timer);
@@ -133,15 +160,52 @@ void TimerQueue::cancelInLoop(TimerId timerId) {
     assert(timers_.size() == activeTimers_.size());
 }
 
+void TimerQueue::restartInLoop(TimerId timerId, Timestamp when) {
+    loop_->assertInLoopThread();
+    if (wheel_) {
+        if (wheel_->restart(timerId.timer_, timerId.sequence_, when)) {
+            resetWheelTimerfd(when);
+        }
+        return;
+    }
+    ActiveTimer timer{timerId.timer_, timerId.sequence_};
+    ActiveTimerSet::iterator it = activeTimers_.find(timer);
+    if (it != activeTimers_.end()) {
+        Timestamp earliest = timers_.begin()->first;
+        size_t n = timers_.erase(Entry{it->first->expiration(), it->first});
+        assert(n == 1);
+        (void)n;
+        it->first->setExpiration(when);
+        timers_.emplace(when, it->first);
+        if (!(timers_.begin()->first == earliest) && !callingExpiredTimers_) {
+            resetTimerfd(timerfd_, timers_.begin()->first);
+        }
+    } else if (callingExpiredTimers_) {
+        // running now, re-inserted by reset()
+        restartingTimers_[timer] = when;
+    }
+    assert(timers_.size() == activeTimers_.size());
+}
+
 void TimerQueue::handleRead() {
     loop_->assertInLoopThread();
     Timestamp now{Timestamp::now()};
     readTimerfd(timerfd_, now);
 
+    if (wheel_) {
+        handleWheelRead(now);
+        return;
+    }
+
     std::vector<Entry> expired = getExpired(now);
+    if (!expired.empty()) {
+        loop_->recordTimerLateness(now.microSecondsSinceEpoch() -
+                                   expired.front().first.microSecondsSinceEpoch());
+    }
 
     callingExpiredTimers_ = true;
     cancelingTimers_.clear();
+    restartingTimers_.clear();
     // safe to callback outside critical section
     for (const Entry& it : expired) {
         it.second->run();
@@ -174,8 +238,15 @@ void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now) {
     Timestamp nextExpire;
     for (const Entry& it : expired) {
         ActiveTimer timer{it.second, it.second->sequence()};
-        if (it.second->repeat() &&
-            cancelingTimers_.find(timer) == cancelingTimers_.end()) {
+        if (cancelingTimers_.find(timer) != cancelingTimers_.end()) {
+            delete it.second;
+            continue;
+        }
+        auto restarting = restartingTimers_.find(timer);
+        if (restarting != restartingTimers_.end()) {
+            it.second->setExpiration(restarting->second);
+            insert(it.second);
+        } else if (it.second->repeat()) {
             it.second->restart(now);
             insert(it.second);
         } else {
@@ -193,6 +264,27 @@ void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now) {
     }
 }
 
+void TimerQueue::handleWheelRead(Timestamp now) {
+    if (wheelArmed_.valid()) {
+        // late from the tick, not from the expiration rounded up to it
+        loop_->recordTimerLateness(now.microSecondsSinceEpoch() -
+                                   wheelArmed_.microSecondsSinceEpoch());
+    }
+    wheel_->expire(now);
+    wheelArmed_ = wheel_->nextExpiration();
+    if (wheelArmed_.valid()) {
+        resetTimerfd(timerfd_, wheelArmed_);
+    }
+}
+
+void TimerQueue::resetWheelTimerfd(Timestamp when) {
+    // only ever move the alarm earlier, handleWheelRead() catches up
+    if (!wheelArmed_.valid() || when < wheelArmed_) {
+        wheelArmed_ = wheel_->nextExpiration();
+        resetTimerfd(timerfd_, wheelArmed_);
+    }
+}
+
 bool TimerQueue::insert(Timer* timer) {
     loop_->assertInLoopThread();
     assert(timers_.size() == activeTimers_.size());
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -15,11 +17,17 @@ namespace net {
 class EventLoop;
 class Timer;
 class TimerId;
+class TimingWheel;
 
 ///
 /// A best efforts timer queue.
 /// No guarantee that the callback will be on time
 ///
+/// Timers are kept in a sorted set by default. Setting the environment
+/// variable FISHNET_USE_TIMING_WHEEL switches to a hierarchical timing
+/// wheel of 1ms ticks, O(1) add, cancel and restart, which pays off with
+/// many timers that are mostly restarted or canceled before they expire.
+///
 class TimerQueue : noncopyable {
 public:
     explicit TimerQueue(EventLoop* loop);
@@ -34,6 +42,12 @@ public:
 
     void cancel(TimerId timerId);
 
+    ///
+    /// Moves the next expiration of a pending or running timer to @c when,
+    /// no-op if the timer has expired or been canceled.
+    ///
+    void restart(TimerId timerId, Timestamp when);
+
 private:
     // FIXME: use unique_ptr<Timer> instead of raw pointers.
     // This requires heterogeneous comparison lookup (N3465) from C++14
@@ -45,6 +59,9 @@ private:
 
     void addTimerInLoop(Timer* timer);
     void cancelInLoop(TimerId timerId);
+    void restartInLoop(TimerId timerId, Timestamp when);
+    void handleWheelRead(Timestamp now);
+    void resetWheelTimerfd(Timestamp when);
     // called when timerfd alarms
     void handleRead();
     // move out all expired timers
@@ -63,6 +80,11 @@ private:
     ActiveTimerSet activeTimers_;
     bool callingExpiredTimers_;
     ActiveTimerSet cancelingTimers_;
+    std::map<ActiveTimer, Timestamp> restartingTimers_;
+
+    // timing wheel mode
+    std::unique_ptr<TimingWheel> wheel_;
+    Timestamp wheelArmed_;  // when timerfd fires, invalid if disarmed
 };
 
 }  // namespace net
@@ -0,0 +1,259 @@
+#include "fishnet/net/timing_wheel.h"
+
+#include <cassert>
+
+#include "fishnet/base/types.h"
+#include "fishnet/net/timer.h"
+
+using namespace fishnet;
+using namespace fishnet::net;
+
+const int64_t TimingWheel::kTickMicroSeconds;
+
+TimingWheel::TimingWheel()
+    : upperSize_(0),
+      size_(0),
+      nextTick_(toTick(Timestamp::now())),
+      freeList_(NULL),
+      running_(NULL),
+      runningCanceled_(false),
+      runningRestarted_(false) {
+    memZero(level0_, sizeof(level0_));
+    memZero(levels_, sizeof(levels_));
+    memZero(level0Bits_, sizeof(level0Bits_));
+}
+
+TimingWheel::~TimingWheel() {
+    for (Timer* head : level0_) {
+        while (head != NULL) {
+            Timer* next = head->next_;
+            delete head;
+            head = next;
+        }
+    }
+    for (auto& level : levels_) {
+        for (Timer* head : level) {
+            while (head != NULL) {
+                Timer* next = head->next_;
+                delete head;
+                head = next;
+            }
+        }
+    }
+    while (freeList_ != NULL) {
+        Timer* next = freeList_->next_;
+        delete freeList_;
+        freeList_ = next;
+    }
+}
+
+Timer* TimingWheel::newTimer(TimerCallback cb, Timestamp when, double interval) {
+    if (freeList_ == NULL) {
+        return new Timer(std::move(cb), when, interval);
+    }
+    Timer* timer = freeList_;
+    freeList_ = timer->next_;
+    timer->next_ = NULL;
+    timer->reuse(std::move(cb), when, interval);
+    return timer;
+}
+
+void TimingWheel::add(Timer* timer) {
+    assert(timer->list_ == NULL);
+    if (size_ == 0 && running_ == NULL) {
+        // nothing pending, skip the idle ticks
+        nextTick_ = toTick(Timestamp::now());
+    }
+    place(timer);
+    ++size_;
+}
+
+void TimingWheel::cancel(Timer* timer, int64_t sequence) {
+    if (!isLive(timer, sequence)) {
+        return;
+    }
+    if (timer == running_) {
+        runningCanceled_ = true;
+        return;
+    }
+    unlink(timer);
+    --size_;
+    release(timer);
+}
+
+bool TimingWheel::restart(Timer* timer, int64_t sequence, Timestamp when) {
+    if (!isLive(timer, sequence)) {
+        return false;
+    }
+    timer->setExpiration(when);
+    if (timer == running_) {
+        runningRestarted_ = true;
+    } else {
+        unlink(timer);
+        place(timer);
+    }
+    return true;
+}
+
+void TimingWheel::expire(Timestamp now) {
+    // round down, tick T holds expirations up to T * kTickMicroSeconds
+    const int64_t nowTick = now.microSecondsSinceEpoch() / kTickMicroSeconds;
+    while (size_ > 0 && nextTick_ <= nowTick) {
+        const int64_t tick = nextTick_;
+        const int index = static_cast<int>(tick & (kLevel0Size - 1));
+        if (index == 0) {
+            // level 0 wraps, bring down the next slot of each level above
+            for (int level = 1; level < kNumLevels; ++level) {
+                int upperIndex = static_cast<int>(
+                    (tick >> (kLevel0Bits + (level - 1) * kLevelBits)) & (kLevelSize - 1));
+                cascade(level, upperIndex);
+                if (upperIndex != 0) {
+                    break;
+                }
+            }
+        }
+
+        // detach the slot, callbacks may add timers for this very tick
+        Timer* expired = NULL;
+        while (level0_[index] != NULL) {
+            Timer* timer = level0_[index];
+            unlink(timer);
+            link(timer, &expired);
+        }
+        ++nextTick_;
+
+        while (expired != NULL) {
+            Timer* timer = expired;
+            unlink(timer);
+            --size_;
+            running_ = timer;
+            runningCanceled_ = false;
+            runningRestarted_ = false;
+            timer->run();
+            running_ = NULL;
+
+            if (runningCanceled_) {
+                release(timer);
+            } else if (runningRestarted_) {
+                add(timer);
+            } else if (timer->repeat()) {
+                timer->restart(now);
+                add(timer);
+            } else {
+                release(timer);
+            }
+        }
+    }
+}
+
+Timestamp TimingWheel::nextExpiration() const {
+    if (size_ == 0) {
+        return Timestamp::invalid();
+    }
+    // with upper levels in use, level 0 must be refilled at its next wrap
+    const int64_t wrapTick = (nextTick_ + kLevel0Size - 1) & ~int64_t{kLevel0Size - 1};
+    const int64_t endTick = upperSize_ > 0 ? wrapTick : nextTick_ + kLevel0Size;
+    for (int64_t tick = nextTick_; tick < endTick; ++tick) {
+        int index = static_cast<int>(tick & (kLevel0Size - 1));
+        if (level0Bits_[index / 64] & (uint64_t{1} << (index % 64))) {
+            return Timestamp(tick * kTickMicroSeconds);
+        }
+    }
+    return Timestamp(endTick * kTickMicroSeconds);
+}
+
+int64_t TimingWheel::toTick(Timestamp when) {
+    // round up, a timer never fires before its expiration
+    return (when.microSecondsSinceEpoch() + kTickMicroSeconds - 1) / kTickMicroSeconds;
+}
+
+void TimingWheel::link(Timer* timer, Timer** list) {
+    timer->prev_ = NULL;
+    timer->next_ = *list;
+    if (*list != NULL) {
+        (*list)->prev_ = timer;
+    }
+    *list = timer;
+    timer->list_ = list;
+}
+
+void TimingWheel::unlink(Timer* timer) {
+    Timer** list = timer->list_;
+    assert(list != NULL);
+    if (timer->prev_ != NULL) {
+        timer->prev_->next_ = timer->next_;
+    } else {
+        *list = timer->next_;
+    }
+    if (timer->next_ != NULL) {
+        timer->next_->prev_ = timer->prev_;
+    }
+    timer->prev_ = NULL;
+    timer->next_ = NULL;
+    timer->list_ = NULL;
+
+    if (list >= level0_ && list < level0_ + kLevel0Size) {
+        if (*list == NULL) {
+            size_t index = static_cast<size_t>(list - level0_);
+            level0Bits_[index / 64] &= ~(uint64_t{1} << (index % 64));
+        }
+    } else if (list >= &levels_[0][0] && list < &levels_[0][0] + (kNumLevels - 1) * kLevelSize) {
+        --upperSize_;
+    }
+}
+
+void TimingWheel::place(Timer* timer) {
+    int64_t tick = toTick(timer->expiration());
+    if (tick < nextTick_) {
+        tick = nextTick_;
+    }
+    int64_t delta = tick - nextTick_;
+    if (delta >= kMaxTicks) {
+        // beyond the wheel, park it in the farthest slot and cascade again later
+        tick = nextTick_ + kMaxTicks - 1;
+        delta = kMaxTicks - 1;
+    }
+
+    if (delta < kLevel0Size) {
+        int index = static_cast<int>(tick & (kLevel0Size - 1));
+        link(timer, &level0_[index]);
+        level0Bits_[index / 64] |= uint64_t{1} << (index % 64);
+        return;
+    }
+    for (int level = 1; level < kNumLevels; ++level) {
+        int shift = kLevel0Bits + level * kLevelBits;
+        if (delta < (int64_t{1} << shift) || level == kNumLevels - 1) {
+            int index = static_cast<int>((tick >> (shift - kLevelBits)) & (kLevelSize - 1));
+            link(timer, &levels_[level - 1][index]);
+            ++upperSize_;
+            return;
+        }
+    }
+}
+
+void TimingWheel::cascade(int level, int index) {
+    Timer** list = &levels_[level - 1][index];
+    Timer* timers = NULL;
+    while (*list != NULL) {
+        Timer* timer = *list;
+        unlink(timer);
+        link(timer, &timers);
+    }
+    while (timers != NULL) {
+        Timer* timer = timers;
+        unlink(timer);
+        place(timer);
+    }
+}
+
+void TimingWheel::release(Timer* timer) {
+    assert(timer->list_ == NULL);
+    timer->clear();
+    timer->next_ = freeList_;
+    freeList_ = timer;
+}
+
+bool TimingWheel::isLive(Timer* timer, int64_t sequence) const {
+    return timer != NULL && timer->sequence() == sequence &&
+           (timer->list_ != NULL || timer == running_);
+}
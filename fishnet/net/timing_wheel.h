@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+#include "fishnet/base/noncopyable.h"
+#include "fishnet/base/timestamp.h"
+#include "fishnet/net/callbacks.h"
+
+namespace fishnet {
+
+namespace net {
+
+class Timer;
+
+///
+/// Hierarchical timing wheel, the O(1) backend of TimerQueue.
+///
+/// Time is cut into ticks of kTickMicroSeconds. Level 0 has one slot per tick
+/// for the next 256 ticks, levels 1..3 have 64 slots each covering 64 times
+/// the span of a slot below, about 18 hours in total. Far timers are
+/// cascaded down when level 0 wraps. Every slot is an intrusive list of
+/// Timer, so add, cancel and restart are O(1).
+///
+/// Timers expire at the first tick not earlier than their expiration, never
+/// before it. Finished timers are kept in a free list and recycled, so a
+/// TimerId of a finished timer stays safe to cancel or restart.
+///
+/// This is an internal class of TimerQueue, loop thread only.
+class TimingWheel : noncopyable {
+public:
+    static const int64_t kTickMicroSeconds = 1000;
+
+    TimingWheel();
+    ~TimingWheel();
+
+    /// A timer from the free list, or a new one.
+    Timer* newTimer(TimerCallback cb, Timestamp when, double interval);
+
+    void add(Timer* timer);
+
+    /// No-op if the timer is not the one of @c sequence any more.
+    void cancel(Timer* timer, int64_t sequence);
+
+    /// Moves the expiration of a live timer to @c when.
+    /// @return false if the timer is not the one of @c sequence any more
+    bool restart(Timer* timer, int64_t sequence, Timestamp when);
+
+    /// Runs the callbacks of all timers expired at @c now.
+    void expire(Timestamp now);
+
+    /// When the wheel must run next, invalid if it holds no timer.
+    Timestamp nextExpiration() const;
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    static const int kLevel0Bits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevel0Size = 1 << kLevel0Bits;
+    static const int kLevelSize = 1 << kLevelBits;
+    static const int kNumLevels = 4;  // level 0 plus 3 upper levels
+    static const int64_t kMaxTicks = int64_t{1} << (kLevel0Bits + 3 * kLevelBits);
+
+    static int64_t toTick(Timestamp when);
+
+    void link(Timer* timer, Timer** list);
+    void unlink(Timer* timer);
+    void place(Timer* timer);
+    void cascade(int level, int index);
+    void release(Timer* timer);
+    bool isLive(Timer* timer, int64_t sequence) const;
+
+    Timer* level0_[kLevel0Size];
+    Timer* levels_[kNumLevels - 1][kLevelSize];
+    uint64_t level0Bits_[kLevel0Size / 64];  // non-empty slots of level 0
+    size_t upperSize_;                       // timers above level 0
+    size_t size_;
+
+    int64_t nextTick_;  // ticks before this one are done
+    Timer* freeList_;
+    Timer* running_;
+    bool runningCanceled_;
+    bool runningRestarted_;
+};
+
+}  // namespace net
+}  // namespace fishnet